@@ -0,0 +1,251 @@
+#include <cmath>
+#include <algorithm>
+
+#include <common/bounds.hpp>
+
+// Directions used to find extreme points for the initial sphere
+static const glm::vec3 extremeDirections[] =
+{
+    glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 1.0f, -1.0f),
+    glm::vec3(1.0f, -1.0f, 1.0f), glm::vec3(1.0f, -1.0f, -1.0f)
+};
+
+// Eigenvectors of a symmetric 3x3 matrix by Jacobi rotations
+static void eigenVectors(double a[3][3], glm::vec3 axes[3])
+{
+    double v[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+
+    for (int sweep = 0; sweep < 16; sweep++)
+    {
+        for (int p = 0; p < 2; p++)
+        {
+            for (int q = p + 1; q < 3; q++)
+            {
+                if (std::abs(a[p][q]) < 1e-12)
+                    continue;
+
+                // Rotation that zeroes a[p][q]
+                double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    double vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+        axes[i] = glm::normalize(glm::vec3(float(v[0][i]), float(v[1][i]), float(v[2][i])));
+}
+
+BoundingBox BoundingBox::transform(const glm::mat4 &matrix) const
+{
+    // Each half extent of the new box sums the absolute contributions of the old ones
+    glm::vec3 centre = glm::vec3(matrix * glm::vec4(this->centre(), 1.0f));
+    glm::vec3 half = 0.5f * size();
+    glm::vec3 newHalf(0.0f);
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            newHalf[i] += std::abs(matrix[j][i]) * half[j];
+
+    BoundingBox result = { centre - newHalf, centre + newHalf };
+    return result;
+}
+
+BoundingSphere BoundingSphere::transform(const glm::mat4 &matrix) const
+{
+    // The radius grows with the largest scale
+    float scale = std::max(glm::length(glm::vec3(matrix[0])),
+                           std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+
+    BoundingSphere result = { glm::vec3(matrix * glm::vec4(centre, 1.0f)), radius * scale };
+    return result;
+}
+
+OrientedBox OrientedBox::transform(const glm::mat4 &matrix) const
+{
+    OrientedBox result;
+    result.centre = glm::vec3(matrix * glm::vec4(centre, 1.0f));
+    for (int i = 0; i < 3; i++)
+    {
+        glm::vec3 axis = glm::mat3(matrix) * axes[i];
+        float length = glm::length(axis);
+        result.axes[i] = length > 0.0f ? axis / length : axes[i];
+        result.halfExtents[i] = halfExtents[i] * length;
+    }
+    return result;
+}
+
+glm::vec3 OrientedBox::pushOut(const glm::vec3 &point, float margin) const
+{
+    // How far inside each pair of faces the point is
+    glm::vec3 offset = point - centre;
+    int axis = 0;
+    float local[3], depth[3];
+    for (int i = 0; i < 3; i++)
+    {
+        local[i] = glm::dot(offset, axes[i]);
+        depth[i] = halfExtents[i] + margin - std::abs(local[i]);
+        if (depth[i] <= 0.0f)
+            return point;
+        if (depth[i] < depth[axis])
+            axis = i;
+    }
+
+    // Leave through the nearest face
+    return point + axes[axis] * (local[axis] < 0.0f ? -depth[axis] : depth[axis]);
+}
+
+MeshBounds MeshBounds::compute(const std::vector<glm::vec3> &points)
+{
+    MeshBounds bounds;
+    if (points.empty())
+    {
+        bounds.box.min = bounds.box.max = glm::vec3(0.0f);
+        bounds.sphere.centre = glm::vec3(0.0f);
+        bounds.sphere.radius = 0.0f;
+        bounds.obb.centre = glm::vec3(0.0f);
+        bounds.obb.axes[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+        bounds.obb.axes[1] = glm::vec3(0.0f, 1.0f, 0.0f);
+        bounds.obb.axes[2] = glm::vec3(0.0f, 0.0f, 1.0f);
+        bounds.obb.halfExtents = glm::vec3(0.0f);
+        return bounds;
+    }
+
+    // Axis aligned box, and the extreme points along a few directions
+    const int directionCount = sizeof(extremeDirections) / sizeof(extremeDirections[0]);
+    size_t minPoint[directionCount] = { 0 }, maxPoint[directionCount] = { 0 };
+    float minProjection[directionCount], maxProjection[directionCount];
+    for (int d = 0; d < directionCount; d++)
+        minProjection[d] = maxProjection[d] = glm::dot(points[0], extremeDirections[d]);
+
+    glm::dvec3 sum(0.0);
+    bounds.box.min = bounds.box.max = points[0];
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const glm::vec3 &p = points[i];
+        bounds.box.min = glm::min(bounds.box.min, p);
+        bounds.box.max = glm::max(bounds.box.max, p);
+        sum += glm::dvec3(p);
+        for (int d = 0; d < directionCount; d++)
+        {
+            float projection = glm::dot(p, extremeDirections[d]);
+            if (projection < minProjection[d])
+            {
+                minProjection[d] = projection;
+                minPoint[d] = i;
+            }
+            if (projection > maxProjection[d])
+            {
+                maxProjection[d] = projection;
+                maxPoint[d] = i;
+            }
+        }
+    }
+
+    // Sphere through the most distant pair of extreme points, grown to take in
+    // every point that is still outside
+    int widest = 0;
+    float widestDistance = -1.0f;
+    for (int d = 0; d < directionCount; d++)
+    {
+        float distance = glm::length(points[maxPoint[d]] - points[minPoint[d]]);
+        if (distance > widestDistance)
+        {
+            widestDistance = distance;
+            widest = d;
+        }
+    }
+    glm::vec3 centre = 0.5f * (points[minPoint[widest]] + points[maxPoint[widest]]);
+    float radius = 0.5f * widestDistance;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        float distance = glm::length(points[i] - centre);
+        if (distance > radius)
+        {
+            float newRadius = 0.5f * (radius + distance);
+            centre += (newRadius - radius) / distance * (points[i] - centre);
+            radius = newRadius;
+        }
+    }
+
+    // The sphere around the box is sometimes smaller
+    glm::vec3 boxCentre = bounds.box.centre();
+    float boxRadius = 0.0f;
+    for (size_t i = 0; i < points.size(); i++)
+        boxRadius = std::max(boxRadius, glm::length(points[i] - boxCentre));
+    bounds.sphere.centre = boxRadius < radius ? boxCentre : centre;
+    bounds.sphere.radius = std::min(radius, boxRadius);
+
+    // Principal axes from the covariance of the points
+    glm::dvec3 mean = sum / double(points.size());
+    double covariance[3][3] = { { 0.0 } };
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        glm::dvec3 d = glm::dvec3(points[i]) - mean;
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                covariance[r][c] += d[r] * d[c];
+    }
+    glm::vec3 axes[3];
+    eigenVectors(covariance, axes);
+    axes[2] = glm::normalize(glm::cross(axes[0], axes[1]));
+
+    glm::vec3 low(glm::dot(points[0], axes[0]), glm::dot(points[0], axes[1]), glm::dot(points[0], axes[2]));
+    glm::vec3 high = low;
+    for (size_t i = 1; i < points.size(); i++)
+    {
+        glm::vec3 projection(glm::dot(points[i], axes[0]), glm::dot(points[i], axes[1]), glm::dot(points[i], axes[2]));
+        low = glm::min(low, projection);
+        high = glm::max(high, projection);
+    }
+
+    // Keep whichever of the oriented and axis aligned boxes is smaller
+    glm::vec3 size = high - low;
+    glm::vec3 boxSize = bounds.box.size();
+    if (size.x * size.y * size.z < boxSize.x * boxSize.y * boxSize.z)
+    {
+        glm::vec3 middle = 0.5f * (low + high);
+        bounds.obb.centre = axes[0] * middle.x + axes[1] * middle.y + axes[2] * middle.z;
+        for (int i = 0; i < 3; i++)
+            bounds.obb.axes[i] = axes[i];
+        bounds.obb.halfExtents = 0.5f * size;
+    }
+    else
+    {
+        bounds.obb.centre = boxCentre;
+        bounds.obb.axes[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+        bounds.obb.axes[1] = glm::vec3(0.0f, 1.0f, 0.0f);
+        bounds.obb.axes[2] = glm::vec3(0.0f, 0.0f, 1.0f);
+        bounds.obb.halfExtents = 0.5f * boxSize;
+    }
+
+    return bounds;
+}
+
+MeshBounds MeshBounds::transform(const glm::mat4 &matrix) const
+{
+    MeshBounds result;
+    result.box = box.transform(matrix);
+    result.sphere = sphere.transform(matrix);
+    result.obb = obb.transform(matrix);
+    return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct BoundingBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    glm::vec3 centre() const { return 0.5f * (min + max); }
+    glm::vec3 size() const { return max - min; }
+
+    // Box around this box after a transformation
+    BoundingBox transform(const glm::mat4 &matrix) const;
+};
+
+// Bounding sphere
+struct BoundingSphere
+{
+    glm::vec3 centre;
+    float radius;
+
+    // Sphere around this sphere after a transformation
+    BoundingSphere transform(const glm::mat4 &matrix) const;
+};
+
+// Oriented bounding box
+struct OrientedBox
+{
+    glm::vec3 centre;
+    glm::vec3 axes[3];      // unit length and perpendicular
+    glm::vec3 halfExtents;  // half the size of the box along each axis
+
+    // Box after a transformation (without shear)
+    OrientedBox transform(const glm::mat4 &matrix) const;
+
+    // Move a point out of the box grown by margin the shortest way, points
+    // that are already outside are returned as they are
+    glm::vec3 pushOut(const glm::vec3 &point, float margin) const;
+};
+
+// Bounding volumes of a mesh in its own space
+struct MeshBounds
+{
+    BoundingBox box;
+    BoundingSphere sphere;
+    OrientedBox obb;
+
+    // Bounds of a set of points. The sphere starts from the most distant pair
+    // of extreme points and grows to take in the rest, the box is oriented
+    // along the principal axes of the points unless the axis aligned box is
+    // smaller.
+    static MeshBounds compute(const std::vector<glm::vec3> &points);
+
+    // Bounds after a transformation, for placing a mesh in the world with an
+    // object's translation, rotation and scale
+    MeshBounds transform(const glm::mat4 &matrix) const;
+};
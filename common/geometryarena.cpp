@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <algorithm>
+#include <string.h>
+
+#include <common/geometryarena.hpp>
+#include <common/vertexformat.hpp>
+#include <common/vertexpulling.hpp>
+
+// Smallest arena buffers, in vertices and indices
+static const unsigned int minimumVertices = 64 * 1024;
+static const unsigned int minimumIndices = 192 * 1024;
+
+unsigned int GeometryArena::boundVAO = 0;
+
+unsigned int RangeAllocator::allocate(unsigned int count)
+{
+    for (size_t i = 0; i < freeRanges.size(); i++)
+    {
+        Range &range = freeRanges[i];
+        if (range.count < count)
+            continue;
+
+        // Take the start of the first range that is big enough
+        unsigned int offset = range.offset;
+        range.offset += count;
+        range.count -= count;
+        if (range.count == 0)
+            freeRanges.erase(freeRanges.begin() + i);
+        used += count;
+        return offset;
+    }
+    return none;
+}
+
+void RangeAllocator::free(unsigned int offset, unsigned int count)
+{
+    if (count == 0)
+        return;
+    used -= count;
+
+    // Insert in offset order and merge with the ranges either side
+    size_t i = 0;
+    while (i < freeRanges.size() && freeRanges[i].offset < offset)
+        i++;
+    Range range = { offset, count };
+    freeRanges.insert(freeRanges.begin() + i, range);
+
+    if (i + 1 < freeRanges.size() && freeRanges[i].offset + freeRanges[i].count == freeRanges[i + 1].offset)
+    {
+        freeRanges[i].count += freeRanges[i + 1].count;
+        freeRanges.erase(freeRanges.begin() + i + 1);
+    }
+    if (i > 0 && freeRanges[i - 1].offset + freeRanges[i - 1].count == freeRanges[i].offset)
+    {
+        freeRanges[i - 1].count += freeRanges[i].count;
+        freeRanges.erase(freeRanges.begin() + i);
+    }
+}
+
+void RangeAllocator::grow(unsigned int newCapacity)
+{
+    if (newCapacity <= capacity)
+        return;
+
+    unsigned int oldCapacity = capacity;
+    capacity = newCapacity;
+    used += newCapacity - oldCapacity;
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+void RangeAllocator::reset(unsigned int newUsed)
+{
+    freeRanges.clear();
+    used = capacity;
+    free(newUsed, capacity - newUsed);
+}
+
+GeometryArena &GeometryArena::get(bool compact, bool tangents, unsigned int indexSize)
+{
+    static GeometryArena arenas[2][2][2] =
+    {
+        {
+            { GeometryArena(false, false, 2), GeometryArena(false, false, 4) },
+            { GeometryArena(false, true, 2), GeometryArena(false, true, 4) }
+        },
+        {
+            { GeometryArena(true, false, 2), GeometryArena(true, false, 4) },
+            { GeometryArena(true, true, 2), GeometryArena(true, true, 4) }
+        }
+    };
+    return arenas[compact ? 1 : 0][tangents ? 1 : 0][indexSize == 2 ? 0 : 1];
+}
+
+GeometryArena::GeometryArena(bool compact, bool tangents, unsigned int indexSize) : compact(compact), tangents(tangents),
+    indexSize(indexSize),
+    stride(compact ? (tangents ? CompactVertexFormat::stride : CompactNoTangentVertexFormat::stride)
+                   : (tangents ? StandardVertexFormat::stride : StandardNoTangentVertexFormat::stride)),
+    VAO(0), vertexBuffer(0), elementBuffer(0), positionVAO(0), positionBuffer(0), vertexTexture(0)
+{
+}
+
+GeometryArena::Handle GeometryArena::allocate(const void *vertexData, unsigned int vertexCount,
+                                              const void *indices, unsigned int indexCount)
+{
+    // Find room, closing gaps first and growing the buffers if that isn't enough
+    unsigned int vertexOffset = vertexRanges.allocate(vertexCount);
+    unsigned int indexOffset = indexRanges.allocate(indexCount);
+    for (int attempt = 0; (vertexOffset == RangeAllocator::none || indexOffset == RangeAllocator::none) && attempt < 2; attempt++)
+    {
+        if (vertexOffset != RangeAllocator::none)
+            vertexRanges.free(vertexOffset, vertexCount);
+        if (indexOffset != RangeAllocator::none)
+            indexRanges.free(indexOffset, indexCount);
+
+        bool fits = vertexRanges.size() - vertexRanges.allocated() >= vertexCount
+                 && indexRanges.size() - indexRanges.allocated() >= indexCount;
+        if (fits && attempt == 0)
+            defragment();
+        else
+            reserve(std::max(vertexRanges.size() + std::max(vertexRanges.size(), vertexCount), minimumVertices),
+                    std::max(indexRanges.size() + std::max(indexRanges.size(), indexCount), minimumIndices));
+
+        vertexOffset = vertexRanges.allocate(vertexCount);
+        indexOffset = indexRanges.allocate(indexCount);
+    }
+
+    // Copy the mesh into its ranges
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * stride, vertexCount * stride, vertexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, elementBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<size_t>(indexOffset) * indexSize,
+                    static_cast<size_t>(indexCount) * indexSize, indices);
+
+    // And its positions on their own
+    std::vector<unsigned char> positions(vertexCount * PositionVertexFormat::stride);
+    for (unsigned int i = 0; i < vertexCount; i++)
+        memcpy(&positions[i * PositionVertexFormat::stride], static_cast<const unsigned char *>(vertexData) + i * stride,
+               PositionVertexFormat::stride);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * PositionVertexFormat::stride,
+                    vertexCount * PositionVertexFormat::stride, positions.empty() ? NULL : &positions[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    Allocation allocation = { vertexOffset, vertexCount, indexOffset, indexCount, true };
+    if (freeHandles.empty())
+    {
+        allocations.push_back(allocation);
+        return static_cast<Handle>(allocations.size() - 1);
+    }
+
+    Handle handle = freeHandles.back();
+    freeHandles.pop_back();
+    allocations[handle] = allocation;
+    return handle;
+}
+
+void GeometryArena::free(Handle handle)
+{
+    Allocation &allocation = allocations[handle];
+    if (!allocation.live)
+        return;
+
+    vertexRanges.free(allocation.vertexOffset, allocation.vertexCount);
+    indexRanges.free(allocation.indexOffset, allocation.indexCount);
+    allocation.live = false;
+    freeHandles.push_back(handle);
+}
+
+void GeometryArena::bind()
+{
+    if (boundVAO != VAO)
+    {
+        glBindVertexArray(VAO);
+        boundVAO = VAO;
+
+        if (VertexPulling::isEnabled())
+        {
+            glActiveTexture(GL_TEXTURE0 + VertexPulling::vertexUnit);
+            glBindTexture(GL_TEXTURE_BUFFER, vertexTexture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+    }
+}
+
+void GeometryArena::bindPositions()
+{
+    if (boundVAO != positionVAO)
+    {
+        glBindVertexArray(positionVAO);
+        boundVAO = positionVAO;
+    }
+}
+
+void GeometryArena::unbind()
+{
+    glBindVertexArray(0);
+    boundVAO = 0;
+}
+
+void GeometryArena::reserve(unsigned int vertexCapacity, unsigned int indexCapacity)
+{
+    printf("Geometry arena grown to %u vertices and %u indices\n", vertexCapacity, indexCapacity);
+
+    // Vertex pulling can only reach as many words as a buffer texture holds
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (maxTexels > 0 && vertexCapacity * stride / 4 > static_cast<size_t>(maxTexels))
+        printf("Geometry arena is larger than a buffer texture, vertex pulling will miss vertices\n");
+
+    // New buffers with the old contents copied to the start
+    unsigned int buffers[3];
+    glGenBuffers(3, buffers);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+    if (vertexBuffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vertexRanges.size() * stride);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<size_t>(indexCapacity) * indexSize, NULL, GL_STATIC_DRAW);
+    if (elementBuffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, elementBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<size_t>(indexRanges.size()) * indexSize);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[2]);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * PositionVertexFormat::stride, NULL, GL_STATIC_DRAW);
+    if (positionBuffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, positionBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vertexRanges.size() * PositionVertexFormat::stride);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &elementBuffer);
+    glDeleteBuffers(1, &positionBuffer);
+    vertexBuffer = buffers[0];
+    elementBuffer = buffers[1];
+    positionBuffer = buffers[2];
+    vertexRanges.grow(vertexCapacity);
+    indexRanges.grow(indexCapacity);
+
+    setupVertexArray();
+}
+
+void GeometryArena::defragment()
+{
+    // Live allocations in buffer order
+    std::vector<Handle> live;
+    for (size_t i = 0; i < allocations.size(); i++)
+        if (allocations[i].live)
+            live.push_back(static_cast<Handle>(i));
+
+    unsigned int buffers[3];
+    glGenBuffers(3, buffers);
+
+    // Pack the vertices, and the positions to the same offsets
+    std::sort(live.begin(), live.end(), [this](Handle a, Handle b)
+    {
+        return allocations[a].vertexOffset < allocations[b].vertexOffset;
+    });
+    glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexRanges.size() * stride, NULL, GL_STATIC_DRAW);
+    unsigned int vertexEnd = 0;
+    for (size_t i = 0; i < live.size(); i++)
+    {
+        Allocation &allocation = allocations[live[i]];
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.vertexOffset * stride,
+                            vertexEnd * stride, allocation.vertexCount * stride);
+        vertexEnd += allocation.vertexCount;
+    }
+
+    const size_t positionStride = PositionVertexFormat::stride;
+    glBindBuffer(GL_COPY_READ_BUFFER, positionBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[2]);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexRanges.size() * positionStride, NULL, GL_STATIC_DRAW);
+    vertexEnd = 0;
+    for (size_t i = 0; i < live.size(); i++)
+    {
+        Allocation &allocation = allocations[live[i]];
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.vertexOffset * positionStride,
+                            vertexEnd * positionStride, allocation.vertexCount * positionStride);
+        allocation.vertexOffset = vertexEnd;
+        vertexEnd += allocation.vertexCount;
+    }
+
+    // Pack the indices, which are relative to the base vertex so don't change
+    std::sort(live.begin(), live.end(), [this](Handle a, Handle b)
+    {
+        return allocations[a].indexOffset < allocations[b].indexOffset;
+    });
+    glBindBuffer(GL_COPY_READ_BUFFER, elementBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<size_t>(indexRanges.size()) * indexSize, NULL, GL_STATIC_DRAW);
+    unsigned int indexEnd = 0;
+    for (size_t i = 0; i < live.size(); i++)
+    {
+        Allocation &allocation = allocations[live[i]];
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<size_t>(allocation.indexOffset) * indexSize,
+                            static_cast<size_t>(indexEnd) * indexSize, static_cast<size_t>(allocation.indexCount) * indexSize);
+        allocation.indexOffset = indexEnd;
+        indexEnd += allocation.indexCount;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &elementBuffer);
+    glDeleteBuffers(1, &positionBuffer);
+    vertexBuffer = buffers[0];
+    elementBuffer = buffers[1];
+    positionBuffer = buffers[2];
+    vertexRanges.reset(vertexEnd);
+    indexRanges.reset(indexEnd);
+
+    setupVertexArray();
+}
+
+void GeometryArena::setupVertexArray()
+{
+    if (VAO == 0)
+        glGenVertexArrays(1, &VAO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    if (compact && tangents)
+        CompactVertexFormat::setup();
+    else if (compact)
+        CompactNoTangentVertexFormat::setup();
+    else if (tangents)
+        StandardVertexFormat::setup();
+    else
+        StandardNoTangentVertexFormat::setup();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+    // Positions only, 12 bytes a vertex whichever the layout
+    if (positionVAO == 0)
+        glGenVertexArrays(1, &positionVAO);
+    glBindVertexArray(positionVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    PositionVertexFormat::setup();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    boundVAO = 0;
+
+    // The same vertices for shaders that fetch them by gl_VertexID
+    if (vertexTexture == 0)
+        glGenTextures(1, &vertexTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, vertexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, vertexBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
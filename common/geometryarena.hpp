@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+// First fit allocator of ranges in a buffer, freed ranges are merged with
+// their neighbours and reused
+class RangeAllocator
+{
+public:
+    RangeAllocator() : capacity(0), used(0) {}
+
+    // Offset of a free range of count elements, or none if nothing is big enough
+    unsigned int allocate(unsigned int count);
+
+    // Return a range to the free list
+    void free(unsigned int offset, unsigned int count);
+
+    // Add free space at the end
+    void grow(unsigned int newCapacity);
+
+    // Forget every allocation except the first used elements, which stay allocated
+    void reset(unsigned int used);
+
+    unsigned int size() const { return capacity; }
+    unsigned int allocated() const { return used; }
+
+    static const unsigned int none = ~0u;
+
+private:
+    struct Range
+    {
+        unsigned int offset;
+        unsigned int count;
+    };
+
+    std::vector<Range> freeRanges;  // sorted by offset
+    unsigned int capacity;
+    unsigned int used;
+};
+
+// Vertex and index buffers shared by every mesh with the same vertex format
+// and index size, drawn from one VAO with base vertex offsets. Meshes get a
+// handle to their ranges, which can move when the arena grows or is
+// defragmented, so offsets are looked up at draw time.
+class GeometryArena
+{
+public:
+    typedef unsigned int Handle;
+
+    // Arena for a vertex layout (compact or standard, with or without
+    // tangents) and index size (2 or 4)
+    static GeometryArena &get(bool compact, bool tangents, unsigned int indexSize);
+
+    // Copy a mesh's interleaved vertices and indices into the arena
+    Handle allocate(const void *vertexData, unsigned int vertexCount, const void *indices, unsigned int indexCount);
+
+    // Give a mesh's ranges back to the arena
+    void free(Handle handle);
+
+    // Where a mesh's ranges are in the shared buffers
+    GLint baseVertex(Handle handle) const { return static_cast<GLint>(allocations[handle].vertexOffset); }
+    size_t indexByteOffset(Handle handle) const { return static_cast<size_t>(allocations[handle].indexOffset) * indexSize; }
+
+    // Index type of the element buffer
+    GLenum indexType() const { return indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+
+    // True for the compact vertex layout
+    bool isCompact() const { return compact; }
+
+    // True if the vertices carry tangents
+    bool hasTangents() const { return tangents; }
+
+    // Bytes per vertex
+    size_t vertexStride() const { return stride; }
+
+    // Bind the arena's VAO unless it already is, and with vertex pulling the
+    // vertex buffer texture too. Code that binds other VAOs calls unbind()
+    // afterwards so the next draw rebinds.
+    void bind();
+    static void unbind();
+
+    // Bind the VAO that reads only the positions, for depth only passes.
+    // Its vertices are at the same offsets and share the element buffer.
+    void bindPositions();
+
+    // Move every mesh to the front of the buffers, closing the gaps left by freed meshes
+    void defragment();
+
+private:
+    struct Allocation
+    {
+        unsigned int vertexOffset;
+        unsigned int vertexCount;
+        unsigned int indexOffset;
+        unsigned int indexCount;
+        bool live;
+    };
+
+    GeometryArena(bool compact, bool tangents, unsigned int indexSize);
+
+    // Replace the buffers with larger ones, keeping their contents
+    void reserve(unsigned int vertexCapacity, unsigned int indexCapacity);
+
+    // Point the VAOs and the vertex texture at the current buffers
+    void setupVertexArray();
+
+    bool compact;
+    bool tangents;
+    unsigned int indexSize;
+    size_t stride;
+
+    std::vector<Allocation> allocations;
+    std::vector<Handle> freeHandles;
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+
+    unsigned int VAO;
+    unsigned int vertexBuffer;
+    unsigned int elementBuffer;
+    unsigned int positionVAO;
+    unsigned int positionBuffer;  // tightly packed copy of the positions
+    unsigned int vertexTexture;  // the vertex buffer as 32-bit words for vertex pulling
+
+    static unsigned int boundVAO;
+};
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <cmath>
+
+#include <common/hlod.hpp>
+#include <common/staticbatch.hpp>
+#include <common/simplify.hpp>
+#include <common/meshoptimise.hpp>
+#include <common/geometryarena.hpp>
+#include <common/textureregistry.hpp>
+#include <common/threadpool.hpp>
+
+// Texels around each tile that repeat its edge so filtering doesn't pick up the neighbours
+static const float tilePadding = 4.0f;
+
+// Largest error the proxies are simplified to, relative to the size of the group
+static const float maxProxyError = 0.02f;
+
+// Texture types baked into the atlases and the colour of tiles whose object has no texture of that type
+static const char *atlasTypes[] = { "diffuse", "normal", "specular" };
+static const glm::vec4 atlasFallbacks[] =
+{
+    glm::vec4(0.5f, 0.5f, 0.5f, 1.0f),
+    glm::vec4(0.5f, 0.5f, 1.0f, 1.0f),
+    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+};
+
+// Texture id of the first texture of a type, or 0
+static unsigned int findTexture(const Model &model, const char *type)
+{
+    for (size_t i = 0; i < model.textures.size(); i++)
+        if (model.textures[i].type == type)
+            return model.textures[i].id;
+    return 0;
+}
+
+// Copy each object's texture of a type into its tile of a new atlas
+static unsigned int bakeAtlas(const std::vector<AtlasTile> &tiles, unsigned int type, unsigned int shaderID,
+                              unsigned int columns, unsigned int rows, unsigned int tileSize)
+{
+    unsigned int atlas;
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, columns * tileSize, rows * tileSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    unsigned int framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        printf("Proxy atlas framebuffer is incomplete\n");
+
+    glUseProgram(shaderID);
+    glUniform1i(glGetUniformLocation(shaderID, "source"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_SCISSOR_TEST);
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        const AtlasTile &tile = tiles[i];
+        GLint x = tile.column * tileSize, y = tile.row * tileSize;
+        glViewport(x, y, tileSize, tileSize);
+        glScissor(x, y, tileSize, tileSize);
+
+        // Plain colour when the object has no texture of this type
+        unsigned int texture = findTexture(*tile.material, atlasTypes[type]);
+        const glm::vec4 &fallback = atlasFallbacks[type];
+        glClearColor(fallback.r, fallback.g, fallback.b, fallback.a);
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (texture == 0)
+            continue;
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glUniform2fv(glGetUniformLocation(shaderID, "uvMin"), 1, &tile.uvMin[0]);
+        glUniform2fv(glGetUniformLocation(shaderID, "uvMax"), 1, &tile.uvMax[0]);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+    glDisable(GL_SCISSOR_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return atlas;
+}
+
+void Hlod::add(unsigned int id, const Model &model, const glm::mat4 &transform)
+{
+    Instance instance = { id, model.mesh, &model, transform };
+    instances.push_back(instance);
+}
+
+void Hlod::build(unsigned int bakeShaderID, float radius, const MeshOptions &options, float keep, unsigned int tileSize)
+{
+    Settings requested = { bakeShaderID, radius, options, keep, tileSize };
+    settings = requested;
+    building = true;
+}
+
+void Hlod::update()
+{
+    if (!building)
+        return;
+
+    // Wait for every mesh to be uploaded (or fail), so its cache has been written
+    if (!merging.valid())
+    {
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            if (!instances[i].mesh->isReady() && !instances[i].mesh->hasFailed())
+                return;
+        }
+
+        for (size_t i = 0; i < instances.size(); i++)
+            builtTransforms[instances[i].id] = instances[i].transform;
+
+        std::vector<Instance> sources = instances;
+        Settings requested = settings;
+        merging = ThreadPool::shared().enqueue([sources, requested]() { return merge(sources, requested); });
+        return;
+    }
+
+    if (merging.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+    std::vector<Merged> merged = merging.get();
+
+    // Quads drawn into the atlas tiles take their corners from gl_VertexID
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    unsigned int quadVAO;
+    glGenVertexArrays(1, &quadVAO);
+
+    for (size_t i = 0; i < merged.size(); i++)
+    {
+        Merged &group = merged[i];
+        group.mesh->upload();
+        group.cluster.bounds = group.mesh->bounds().sphere;
+
+        // Bake the textures of the objects into the proxy's atlases
+        Model proxy(group.mesh, *group.material);
+        for (size_t t = 0; t < proxy.textures.size(); t++)
+            TextureRegistry::release(proxy.textures[t].id);
+        proxy.textures.clear();
+        glBindVertexArray(quadVAO);
+        for (unsigned int type = 0; type < 3; type++)
+        {
+            Texture texture;
+            texture.id = bakeAtlas(group.tiles, type, settings.bakeShaderID, group.columns, group.rows, settings.tileSize);
+            texture.type = atlasTypes[type];
+            proxy.textures.push_back(texture);
+        }
+
+        clusters.push_back(group.cluster);
+        proxies.push_back(proxy);
+    }
+
+    glDeleteVertexArrays(1, &quadVAO);
+    GeometryArena::unbind();
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    building = false;
+    instances.clear();
+}
+
+std::vector<Hlod::Merged> Hlod::merge(const std::vector<Instance> &instances, const Settings &settings)
+{
+    // Read each mesh back once
+    std::map<const Mesh *, BatchGeometry> sources;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const Mesh *source = instances[i].mesh.get();
+        if (sources.count(source) || source->hasFailed())
+            continue;
+
+        BatchGeometry &geometry = sources[source];
+        if (!source->readGeometry(geometry.vertices, geometry.uvs, geometry.normals, geometry.indices))
+            printf("Unable to read a mesh back for a proxy mesh\n");
+    }
+
+    // Greedy groups: each object not yet in a group starts one and takes in
+    // the other free objects whose origins are within radius of its own
+    std::vector<std::vector<size_t> > groups;
+    std::vector<bool> grouped(instances.size(), false);
+    for (size_t seed = 0; seed < instances.size(); seed++)
+    {
+        if (grouped[seed])
+            continue;
+
+        std::vector<size_t> group;
+        glm::vec3 origin = glm::vec3(instances[seed].transform[3]);
+        for (size_t i = seed; i < instances.size(); i++)
+        {
+            if (!grouped[i] && glm::length(glm::vec3(instances[i].transform[3]) - origin) <= settings.radius)
+            {
+                grouped[i] = true;
+                group.push_back(i);
+            }
+        }
+        groups.push_back(group);
+    }
+
+    std::vector<Merged> proxies;
+    unsigned int tileSize = settings.tileSize;
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        const std::vector<size_t> &group = groups[g];
+        if (group.size() < 2)
+            continue;
+
+        // One atlas tile per object
+        Merged merged;
+        merged.columns = static_cast<unsigned int>(std::ceil(std::sqrt(float(group.size()))));
+        merged.rows = (static_cast<unsigned int>(group.size()) + merged.columns - 1) / merged.columns;
+        merged.material = instances[group[0]].material;
+        glm::vec2 atlasSize(float(merged.columns * tileSize), float(merged.rows * tileSize));
+        float inner = tileSize - 2.0f * tilePadding;
+
+        // Merge the objects in the world, moving each one's uvs into its tile
+        std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+        for (size_t k = 0; k < group.size(); k++)
+        {
+            const Instance &instance = instances[group[k]];
+            const BatchGeometry &geometry = sources[instance.mesh.get()];
+            merged.cluster.members.push_back(instance.id);
+            if (geometry.indices.empty())
+                continue;
+
+            size_t base = mesh->vertices.size();
+            StaticBatch::append(*mesh, geometry, instance.transform);
+
+            glm::vec2 uvMin = mesh->uvs[base], uvMax = mesh->uvs[base];
+            for (size_t v = base; v < mesh->uvs.size(); v++)
+            {
+                uvMin = glm::min(uvMin, mesh->uvs[v]);
+                uvMax = glm::max(uvMax, mesh->uvs[v]);
+            }
+            glm::vec2 uvSize = glm::max(uvMax - uvMin, glm::vec2(1e-4f));
+
+            AtlasTile tile;
+            tile.material = instance.material;
+            tile.column = static_cast<unsigned int>(k) % merged.columns;
+            tile.row = static_cast<unsigned int>(k) / merged.columns;
+            tile.uvMin = uvMin - uvSize * (tilePadding / inner);
+            tile.uvMax = uvMin + uvSize * ((tileSize - tilePadding) / inner);
+            merged.tiles.push_back(tile);
+
+            glm::vec2 origin = glm::vec2(float(tile.column * tileSize), float(tile.row * tileSize)) + tilePadding;
+            for (size_t v = base; v < mesh->uvs.size(); v++)
+                mesh->uvs[v] = (origin + (mesh->uvs[v] - uvMin) / uvSize * inner) / atlasSize;
+        }
+        if (mesh->indices.empty())
+            continue;
+
+        // Simplify the merged mesh and drop the vertices it no longer uses
+        size_t sourceTriangles = mesh->indices.size() / 3;
+        MeshSimplifier::simplify(mesh->indices, mesh->vertices, static_cast<size_t>(mesh->indices.size() * settings.keep) / 3 * 3, maxProxyError);
+        std::vector<unsigned int> order = MeshOptimiser::optimiseVertexFetch(mesh->indices, mesh->vertices.size());
+        MeshOptimiser::remap(mesh->vertices, order);
+        MeshOptimiser::remap(mesh->uvs, order);
+        MeshOptimiser::remap(mesh->normals, order);
+
+        std::string name = "proxy " + std::to_string(proxies.size());
+        printf("Merged %u objects into %s, %u of %u triangles\n", static_cast<unsigned int>(group.size()), name.c_str(),
+               static_cast<unsigned int>(mesh->indices.size() / 3), static_cast<unsigned int>(sourceTriangles));
+        if (!mesh->build(name.c_str(), settings.options))
+            continue;
+
+        merged.mesh = mesh;
+        proxies.push_back(merged);
+    }
+
+    return proxies;
+}
+
+bool Hlod::useProxy(unsigned int cluster, const glm::vec3 &eye, float fov, float screenHeight, float maxPixels) const
+{
+    // Never from inside the group
+    const BoundingSphere &bounds = clusters[cluster].bounds;
+    float distance = glm::length(eye - bounds.centre);
+    if (distance <= bounds.radius)
+        return false;
+
+    // Pixels covered by the radius of the group at this distance
+    float pixels = bounds.radius * 0.5f * screenHeight / (distance * std::tan(0.5f * fov));
+    return pixels < maxPixels;
+}
+
+bool Hlod::hasMoved(unsigned int id, const glm::mat4 &transform) const
+{
+    std::map<unsigned int, glm::mat4>::const_iterator it = builtTransforms.find(id);
+    return it == builtTransforms.end() || it->second != transform;
+}
+
+void Hlod::draw(unsigned int cluster, unsigned int &shaderID)
+{
+    proxies[cluster].draw(shaderID);
+}
+
+void Hlod::drawPositions(unsigned int cluster)
+{
+    proxies[cluster].drawPositions();
+}
+
+void Hlod::deleteBuffers()
+{
+    for (size_t i = 0; i < proxies.size(); i++)
+    {
+        proxies[i].mesh->deleteBuffers();
+        for (size_t t = 0; t < proxies[i].textures.size(); t++)
+            glDeleteTextures(1, &proxies[i].textures[t].id);
+    }
+    proxies.clear();
+    clusters.clear();
+}
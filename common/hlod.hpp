@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <future>
+
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+#include "bounds.hpp"
+
+// Where one object's uvs went in a proxy's atlases
+struct AtlasTile
+{
+    const Model *material;
+    unsigned int column;
+    unsigned int row;
+    glm::vec2 uvMin;  // source uvs that cover the whole tile, padding included
+    glm::vec2 uvMax;
+};
+
+// Hierarchical level of detail: groups of nearby objects merged into one
+// simplified proxy mesh with its own baked textures. A group that is small
+// on screen is drawn as its proxy with one call instead of one per object.
+// The proxies are merged and simplified on the thread pool once the objects'
+// meshes have loaded, only their upload and atlases are done on the GL thread.
+class Hlod
+{
+public:
+    // Add an object with the mesh and textures of a model, placed by
+    // transform. id is the caller's name for the object (its index in the
+    // scene), members() returns these. The model has to outlive the build.
+    void add(unsigned int id, const Model &model, const glm::mat4 &transform);
+
+    // Group objects whose origins are within radius of the first object of
+    // the group and build a proxy for every group of more than one object,
+    // once update() finds their meshes loaded. Each proxy keeps about keep
+    // of the group's triangles, and each object's textures are copied into a
+    // tileSize square tile of the proxy's atlases by bakeShaderID.
+    void build(unsigned int bakeShaderID, float radius, const MeshOptions &options = MeshOptions(),
+               float keep = 0.25f, unsigned int tileSize = 256);
+
+    // Start building the proxies once the meshes are ready, and upload them
+    // and bake their atlases once they have been built. Call once per frame
+    // from the GL context thread.
+    void update();
+
+    // Number of groups with a proxy, and the objects in each
+    unsigned int clusterCount() const { return static_cast<unsigned int>(clusters.size()); }
+    const std::vector<unsigned int> &members(unsigned int cluster) const { return clusters[cluster].members; }
+
+    // True when the group covers less than maxPixels of radius on screen
+    bool useProxy(unsigned int cluster, const glm::vec3 &eye, float fov, float screenHeight, float maxPixels) const;
+
+    // True if an object's transform isn't the one its proxy was built with
+    bool hasMoved(unsigned int id, const glm::mat4 &transform) const;
+
+    // Draw a group's proxy, its vertices are in the world so the caller
+    // sets the view and projection matrices
+    void draw(unsigned int cluster, unsigned int &shaderID);
+
+    // Draw the positions of a group's proxy, for depth only passes
+    void drawPositions(unsigned int cluster);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    struct Instance
+    {
+        unsigned int id;
+        std::shared_ptr<Mesh> mesh;
+        const Model *material;
+        glm::mat4 transform;
+    };
+
+    struct Cluster
+    {
+        std::vector<unsigned int> members;
+        BoundingSphere bounds;
+    };
+
+    // Proxy built on the thread pool, waiting for its upload and atlases
+    struct Merged
+    {
+        Cluster cluster;
+        std::shared_ptr<Mesh> mesh;
+        const Model *material;
+        std::vector<AtlasTile> tiles;
+        unsigned int columns;
+        unsigned int rows;
+    };
+
+    // What build() was asked for
+    struct Settings
+    {
+        unsigned int bakeShaderID;
+        float radius;
+        MeshOptions options;
+        float keep;
+        unsigned int tileSize;
+    };
+
+    std::vector<Instance> instances;
+    std::map<unsigned int, glm::mat4> builtTransforms;
+    std::vector<Cluster> clusters;
+    std::vector<Model> proxies;  // one per cluster
+    Settings settings;
+    bool building = false;
+    std::future<std::vector<Merged> > merging;
+
+    // Group the objects and merge and simplify each group, on a pool thread
+    static std::vector<Merged> merge(const std::vector<Instance> &instances, const Settings &settings);
+};
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/impostor.hpp>
+#include <common/geometryarena.hpp>
+
+// Empty RGBA atlas for the baked views
+static unsigned int createAtlas(unsigned int width, unsigned int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+Impostor::Impostor() : colourAtlas(0), normalAtlas(0), viewCount(0), columns(0), rows(0), VAO(0),
+    centre(0.0f), sphereRadius(0.0f), ka(0.0f), kd(0.0f), ks(0.0f), Ns(1.0f)
+{
+}
+
+bool Impostor::bake(Model &model, unsigned int bakeShaderID, unsigned int views, unsigned int resolution)
+{
+    if (!model.isReady() || views == 0)
+        return false;
+    deleteBuffers();
+
+    // Square-ish grid of views
+    viewCount = views;
+    columns = static_cast<unsigned int>(std::ceil(std::sqrt(float(views))));
+    rows = (views + columns - 1) / columns;
+    unsigned int width = columns * resolution, height = rows * resolution;
+
+    // Frame every view on the bounding sphere
+    centre = model.bounds().sphere.centre;
+    sphereRadius = glm::max(model.bounds().sphere.radius, 1e-4f);
+    ka = model.ka;
+    kd = model.kd;
+    ks = model.ks;
+    Ns = model.Ns;
+
+    // Offscreen framebuffer writing colour and normal to the two atlases
+    colourAtlas = createAtlas(width, height);
+    normalAtlas = createAtlas(width, height);
+    unsigned int framebuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colourAtlas, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalAtlas, 0);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete)
+    {
+        // Transparent where the model doesn't cover the atlas
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // Orthographic views from evenly spaced directions around the vertical axis
+        glUseProgram(bakeShaderID);
+        float r = sphereRadius;
+        glm::mat4 projection = glm::ortho(-r, r, -r, r, r, 3.0f * r);
+        for (unsigned int i = 0; i < viewCount; i++)
+        {
+            float yaw = 2.0f * glm::pi<float>() * i / viewCount;
+            glm::vec3 direction(std::sin(yaw), 0.0f, std::cos(yaw));
+            glm::mat4 view = glm::lookAt(centre + 2.0f * r * direction, centre, glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::mat4 MVP = projection * view;
+
+            glViewport((i % columns) * resolution, (i / columns) * resolution, resolution, resolution);
+            glUniformMatrix4fv(glGetUniformLocation(bakeShaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
+            glUniformMatrix4fv(glGetUniformLocation(bakeShaderID, "MV"), 1, GL_FALSE, &view[0][0]);
+            model.draw(bakeShaderID);
+        }
+
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+    else
+    {
+        printf("Impostor framebuffer is incomplete\n");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    if (!complete)
+    {
+        deleteBuffers();
+        return false;
+    }
+
+    // Mipmaps for when the quads are small
+    glBindTexture(GL_TEXTURE_2D, colourAtlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, normalAtlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenVertexArrays(1, &VAO);
+    printf("Baked %u impostor views into %ux%u atlases\n", viewCount, width, height);
+    return true;
+}
+
+float Impostor::radius(const glm::mat4 &transform) const
+{
+    float scale = glm::max(glm::length(glm::vec3(transform[0])),
+                           glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    return sphereRadius * scale;
+}
+
+void Impostor::draw(unsigned int &shaderID, const glm::mat4 &transform, const Camera &camera)
+{
+    if (!isBaked())
+        return;
+
+    // The two baked views either side of the direction to the camera, in the model's space
+    glm::vec3 toEye = glm::vec3(glm::inverse(transform) * glm::vec4(camera.eye, 1.0f)) - centre;
+    float position = std::atan2(toEye.x, toEye.z) / (2.0f * glm::pi<float>()) * viewCount;
+    if (position < 0.0f)
+        position += viewCount;
+    unsigned int first = static_cast<unsigned int>(position) % viewCount;
+    unsigned int second = (first + 1) % viewCount;
+    float blend = position - std::floor(position);
+
+    glm::vec2 cellSize(1.0f / columns, 1.0f / rows);
+    glm::vec2 firstCell = glm::vec2(float(first % columns), float(first / columns)) * cellSize;
+    glm::vec2 secondCell = glm::vec2(float(second % columns), float(second / columns)) * cellSize;
+
+    // Quad through the object's centre in view space
+    glm::vec3 viewCentre = glm::vec3(camera.view * transform * glm::vec4(centre, 1.0f));
+    float quadRadius = radius(transform);
+
+    glUniform3fv(glGetUniformLocation(shaderID, "centre"), 1, &viewCentre[0]);
+    glUniform1f(glGetUniformLocation(shaderID, "radius"), quadRadius);
+    glUniformMatrix4fv(glGetUniformLocation(shaderID, "P"), 1, GL_FALSE, &camera.projection[0][0]);
+    glUniform2fv(glGetUniformLocation(shaderID, "firstCell"), 1, &firstCell[0]);
+    glUniform2fv(glGetUniformLocation(shaderID, "secondCell"), 1, &secondCell[0]);
+    glUniform2fv(glGetUniformLocation(shaderID, "cellSize"), 1, &cellSize[0]);
+    glUniform1f(glGetUniformLocation(shaderID, "blend"), blend);
+    glUniform1f(glGetUniformLocation(shaderID, "ka"), ka);
+    glUniform1f(glGetUniformLocation(shaderID, "kd"), kd);
+    glUniform1f(glGetUniformLocation(shaderID, "ks"), ks);
+    glUniform1f(glGetUniformLocation(shaderID, "Ns"), Ns);
+
+    // Bind the atlases
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colourAtlas);
+    glUniform1i(glGetUniformLocation(shaderID, "colourAtlas"), 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalAtlas);
+    glUniform1i(glGetUniformLocation(shaderID, "normalAtlas"), 1);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Draw the quad, then let the next mesh rebind its arena
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    GeometryArena::unbind();
+}
+
+void Impostor::deleteBuffers()
+{
+    if (colourAtlas != 0)
+        glDeleteTextures(1, &colourAtlas);
+    if (normalAtlas != 0)
+        glDeleteTextures(1, &normalAtlas);
+    if (VAO != 0)
+        glDeleteVertexArrays(1, &VAO);
+    colourAtlas = normalAtlas = VAO = 0;
+}
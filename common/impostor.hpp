@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+#include "camera.hpp"
+
+// A model rendered ahead of time from a ring of directions around its
+// vertical axis, drawn as one camera facing quad when it is far away. The
+// views are baked through an offscreen framebuffer into a colour atlas and a
+// normal atlas, so the quad is still lit by the scene's lights. The two views
+// either side of the camera's direction are blended to hide the switch
+// between them.
+class Impostor
+{
+public:
+    // Constructor
+    Impostor();
+
+    // Render a model that has been uploaded from viewCount directions, each
+    // into a resolution x resolution cell of the atlases. bakeShaderID writes
+    // the diffuse colour and the bake camera space normal to two outputs.
+    bool bake(Model &model, unsigned int bakeShaderID, unsigned int viewCount = 16, unsigned int resolution = 128);
+
+    // True once the atlases exist
+    bool isBaked() const { return colourAtlas != 0; }
+
+    // Radius of the quad for an object with the given model matrix, for
+    // deciding when the impostor is small enough on screen to replace the model
+    float radius(const glm::mat4 &transform) const;
+
+    // Draw the impostor of an object placed by transform with the impostor
+    // shader, whose light uniforms the caller has set. Objects are expected
+    // to be turned about their vertical axis only.
+    void draw(unsigned int &shaderID, const glm::mat4 &transform, const Camera &camera);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    // Atlases, views are laid out left to right then bottom to top
+    unsigned int colourAtlas;
+    unsigned int normalAtlas;
+    unsigned int viewCount;
+    unsigned int columns;
+    unsigned int rows;
+
+    // Empty VAO for drawing the quad, whose corners come from gl_VertexID
+    unsigned int VAO;
+
+    // Bounding sphere the views were framed on, in the model's space
+    glm::vec3 centre;
+    float sphereRadius;
+
+    // Lighting coefficients of the model
+    float ka, kd, ks, Ns;
+};
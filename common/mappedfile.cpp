@@ -0,0 +1,109 @@
+#include <common/mappedfile.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : bytes(NULL), length(0)
+{
+#ifdef _WIN32
+    fileHandle = NULL;
+    mappingHandle = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    close();
+
+#ifdef _WIN32
+    // Open the file and create a read-only view of the whole file
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    bytes = static_cast<const char *>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    // Open the file and map it into the address space
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(NULL, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    // The file is read front to back so ask for aggressive read-ahead
+    madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    bytes = static_cast<const char *>(view);
+    length = static_cast<size_t>(info.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    fileHandle = NULL;
+    mappingHandle = NULL;
+#else
+    munmap(const_cast<char *>(bytes), length);
+#endif
+
+    bytes = NULL;
+    length = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    // Constructor and destructor
+    MappedFile();
+    ~MappedFile();
+
+    // Map the file at path, returns false if it can't be opened or mapped
+    bool open(const char *path);
+
+    // Unmap the file
+    void close();
+
+    // Mapped bytes
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char *bytes;
+    size_t length;
+
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+
+    // Mappings can't be copied
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
@@ -0,0 +1,631 @@
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "mesh.hpp"
+#include "objloader.hpp"
+#include "threadpool.hpp"
+#include "paths.hpp"
+#include "meshoptimise.hpp"
+#include "vertexformat.hpp"
+#include "tangents.hpp"
+#include "simplify.hpp"
+#include "meshlets.hpp"
+
+std::mutex MeshLoader::mutex;
+std::deque<std::shared_ptr<Mesh> > MeshLoader::uploads;
+unsigned int MeshLoader::loading = 0;
+std::map<std::string, MeshRegistry::Entry> MeshRegistry::meshes;
+
+Mesh::Mesh() : ready(false), failed(false), localBounds(), arena(NULL), allocation(0), indexSize(0), indexType(0)
+{
+}
+
+bool Mesh::load(const char *path, const MeshOptions &options)
+{
+    sourcePath = path;
+    sourceOptions = options;
+
+    // Packed meshes only need decoding
+    if (MeshCodec::isPacked(path))
+    {
+        if (!packed.open(path, options.compact))
+        {
+            failed = true;
+            return false;
+        }
+
+        // The layout bits only pick what the mesh is decoded into
+        const unsigned int layoutFlags = MeshOptions::compactFlag | MeshOptions::derivedTangentsFlag;
+        if ((packed.flags() | layoutFlags) != (options.flags() | layoutFlags))
+            printf("Packed mesh %s was made with different options, using it as it is\n", path);
+
+        // Leave the decoded tangents out of the vertices when the material derives them
+        MeshStreams decoded = packed.streams();
+        if (options.derivedTangents)
+        {
+            decoded.derivedTangents = true;
+            decoded.tangents = NULL;
+        }
+        useStreams(decoded);
+        return true;
+    }
+
+    // Use the binary cache if it's up to date with the .obj file, the buffers
+    // are then filled straight from the mapped file
+    if (cache.open(path, options.flags()))
+    {
+        printf("Loading cached mesh %s\n", MeshCache::cachePath(path, options.flags()).c_str());
+        useStreams(cache.streams());
+        return true;
+    }
+
+    // Load object
+    bool res = loadObj(path, vertices, uvs, normals, indices);
+    if (!res || indices.empty())
+    {
+        failed = true;
+        return false;
+    }
+
+    process(path, options);
+    interleave();
+
+    // Save the binary cache for the next run
+    if (!MeshCache::write(path, streams, options.flags()))
+        printf("Unable to write mesh cache %s\n", MeshCache::cachePath(path, options.flags()).c_str());
+
+    return true;
+}
+
+bool Mesh::pack(const char *path, const MeshOptions &options)
+{
+    if (streams.compact || streams.derivedTangents || streams.vertexCount == 0)
+        return false;
+
+    // Meshes from the cache only have their interleaved vertices
+    if (streams.vertices == NULL)
+    {
+        unpack();
+        streams.vertices = &vertices[0];
+        streams.uvs = &uvs[0];
+        streams.normals = &normals[0];
+        streams.tangents = &tangents[0];
+    }
+
+    return MeshCodec::write(path, streams, options.flags());
+}
+
+bool Mesh::readGeometry(std::vector<glm::vec3> &outVertices, std::vector<glm::vec2> &outUVs,
+                        std::vector<glm::vec3> &outNormals, std::vector<unsigned int> &outIndices) const
+{
+    if (sourcePath.empty())
+        return false;
+
+    // Load it again the same way, which finds the cache written by the first load
+    Mesh copy;
+    if (!copy.load(sourcePath.c_str(), sourceOptions))
+        return false;
+    copy.unpack();
+
+    outVertices.swap(copy.vertices);
+    outUVs.swap(copy.uvs);
+    outNormals.swap(copy.normals);
+    outIndices.assign(copy.indices.begin(), copy.indices.begin() + copy.lods[0].indexCount);
+    return true;
+}
+
+void Mesh::unpack()
+{
+    // Meshes loaded from the .obj file still have their attributes
+    if (!vertices.empty())
+        return;
+
+    // The attributes are at the same offsets with or without the tangent
+    vertices.resize(streams.vertexCount);
+    uvs.resize(streams.vertexCount);
+    normals.resize(streams.vertexCount);
+    tangents.resize(streams.derivedTangents ? 0 : streams.vertexCount);
+    size_t stride = streams.vertexSize();
+    const unsigned char *source = static_cast<const unsigned char *>(streams.interleaved);
+    for (size_t i = 0; i < streams.vertexCount; i++)
+    {
+        const unsigned char *vertex = source + i * stride;
+        memcpy(&vertices[i], vertex + StandardVertexFormat::offset<PositionAttribute>(), sizeof(glm::vec3));
+        if (streams.compact)
+        {
+            glm::uint32 uv, normal, tangent;
+            memcpy(&uv, vertex + CompactVertexFormat::offset<HalfUVAttribute>(), sizeof(uv));
+            memcpy(&normal, vertex + CompactVertexFormat::offset<PackedNormalAttribute>(), sizeof(normal));
+            uvs[i] = glm::unpackHalf2x16(uv);
+            normals[i] = glm::vec3(glm::unpackSnorm3x10_1x2(normal));
+            if (!streams.derivedTangents)
+            {
+                memcpy(&tangent, vertex + CompactVertexFormat::offset<PackedTangentAttribute>(), sizeof(tangent));
+                tangents[i] = glm::unpackSnorm3x10_1x2(tangent);
+            }
+        }
+        else
+        {
+            memcpy(&uvs[i], vertex + StandardVertexFormat::offset<UVAttribute>(), sizeof(glm::vec2));
+            memcpy(&normals[i], vertex + StandardVertexFormat::offset<NormalAttribute>(), sizeof(glm::vec3));
+            if (!streams.derivedTangents)
+                memcpy(&tangents[i], vertex + StandardVertexFormat::offset<TangentAttribute>(), sizeof(glm::vec4));
+        }
+    }
+
+    if (streams.indexSize == sizeof(unsigned short))
+    {
+        const unsigned short *source = static_cast<const unsigned short *>(streams.indices);
+        indices.assign(source, source + streams.indexCount);
+    }
+    else
+    {
+        const unsigned int *source = static_cast<const unsigned int *>(streams.indices);
+        indices.assign(source, source + streams.indexCount);
+    }
+}
+
+void Mesh::useStreams(const MeshStreams &loaded)
+{
+    streams = loaded;
+    lods.assign(streams.lods, streams.lods + streams.lodCount);
+    meshlets.assign(streams.meshlets, streams.meshlets + streams.meshletCount);
+    localBounds = streams.bounds;
+    interleave();
+}
+
+bool Mesh::build(const char *name, const MeshOptions &options)
+{
+    if (indices.empty() || uvs.size() != vertices.size() || normals.size() != vertices.size())
+        return false;
+
+    process(name, options);
+    interleave();
+    return true;
+}
+
+void Mesh::process(const char *path, const MeshOptions &options)
+{
+    // Optional reordering for the GPU
+    if (options.optimise)
+        optimise(path);
+
+    // Calculate the tangent frames, unless the material derives them per pixel
+    if (!options.derivedTangents)
+        TangentGenerator::generate(vertices, uvs, normals, indices, tangents);
+
+    // Simplified levels of detail share the vertices
+    buildLods(path, options.lods, options.optimise);
+
+    // Meshlets of the full detail level for culling
+    if (options.meshlets)
+    {
+        meshlets = Meshlets::build(indices, lods[0].indexCount, vertices);
+        printf("Split %s into %u meshlets\n", path, static_cast<unsigned int>(meshlets.size()));
+    }
+
+    // Point the streams at the attributes, packing them first for the compact layout
+    streams.vertices = &vertices[0];
+    streams.derivedTangents = options.derivedTangents;
+    if (options.compact)
+    {
+        packCompact();
+        streams.compact = true;
+        streams.uvs = &packedUVs[0];
+        streams.normals = &packedNormals[0];
+        streams.tangents = packedTangents.empty() ? NULL : &packedTangents[0];
+    }
+    else
+    {
+        streams.uvs = &uvs[0];
+        streams.normals = &normals[0];
+        streams.tangents = tangents.empty() ? NULL : &tangents[0];
+    }
+    streams.vertexCount = static_cast<unsigned int>(vertices.size());
+    printf("%u vertices of %u bytes\n", streams.vertexCount, static_cast<unsigned int>(streams.vertexSize()));
+
+    // Use 16-bit indices when the mesh is small enough
+    streams.indexCount = static_cast<unsigned int>(indices.size());
+    streams.lods = &lods[0];
+    streams.lodCount = static_cast<unsigned int>(lods.size());
+    streams.meshlets = meshlets.empty() ? NULL : &meshlets[0];
+    streams.meshletCount = static_cast<unsigned int>(meshlets.size());
+    if (vertices.size() <= 65536)
+    {
+        shortIndices.assign(indices.begin(), indices.end());
+        streams.indices = &shortIndices[0];
+        streams.indexSize = sizeof(unsigned short);
+    }
+    else
+    {
+        streams.indices = &indices[0];
+        streams.indexSize = sizeof(unsigned int);
+    }
+
+    // Bounding volumes
+    localBounds = MeshBounds::compute(vertices);
+    streams.bounds = localBounds;
+}
+
+void Mesh::upload()
+{
+    // Setup buffers
+    setupBuffers(streams);
+
+    // The streams have been copied to the GPU so the mapping and packed data can go
+    streams = MeshStreams();
+    cache.close();
+    packed.close();
+    std::vector<unsigned short>().swap(shortIndices);
+    std::vector<unsigned char>().swap(vertexData);
+    std::vector<unsigned int>().swap(packedUVs);
+    std::vector<unsigned int>().swap(packedNormals);
+    std::vector<unsigned int>().swap(packedTangents);
+    ready = true;
+}
+
+unsigned int Mesh::selectLod(float pixelsPerUnit, unsigned int current, float maxPixelError) const
+{
+    if (lods.size() < 2)
+        return 0;
+    if (current >= lods.size())
+        current = static_cast<unsigned int>(lods.size()) - 1;
+
+    // Coarsest level whose error covers no more than maxPixelError pixels
+    glm::vec3 size = localBounds.box.size();
+    float pixelsPerError = glm::max(size.x, glm::max(size.y, size.z)) * pixelsPerUnit;
+    unsigned int lod = 0;
+    for (unsigned int i = static_cast<unsigned int>(lods.size()) - 1; i > 0; i--)
+    {
+        if (lods[i].error * pixelsPerError <= maxPixelError)
+        {
+            lod = i;
+            break;
+        }
+    }
+
+    // Only step down to a coarser level once it is comfortably within the error
+    const float hysteresis = 0.75f;
+    while (lod > current && lods[lod].error * pixelsPerError > maxPixelError * hysteresis)
+        lod--;
+
+    return lod;
+}
+
+void Mesh::draw(unsigned int lod)
+{
+    if (!ready)
+        return;
+    if (lod >= lods.size())
+        lod = static_cast<unsigned int>(lods.size()) - 1;
+
+    // Draw the triangles of the level of detail from the mesh's ranges in the arena
+    size_t offset = arena->indexByteOffset(allocation) + static_cast<size_t>(lods[lod].indexOffset) * indexSize;
+    arena->bind();
+    glDrawElementsBaseVertex(GL_TRIANGLES, lods[lod].indexCount, indexType, (void*)offset, arena->baseVertex(allocation));
+}
+
+void Mesh::drawPositions(unsigned int lod)
+{
+    if (!ready)
+        return;
+    if (lod >= lods.size())
+        lod = static_cast<unsigned int>(lods.size()) - 1;
+
+    // The same ranges through the arena's position only VAO
+    size_t offset = arena->indexByteOffset(allocation) + static_cast<size_t>(lods[lod].indexOffset) * indexSize;
+    arena->bindPositions();
+    glDrawElementsBaseVertex(GL_TRIANGLES, lods[lod].indexCount, indexType, (void*)offset, arena->baseVertex(allocation));
+}
+
+void Mesh::drawInstanced(unsigned int count, unsigned int lod)
+{
+    if (!ready || count == 0)
+        return;
+    if (lod >= lods.size())
+        lod = static_cast<unsigned int>(lods.size()) - 1;
+
+    size_t offset = arena->indexByteOffset(allocation) + static_cast<size_t>(lods[lod].indexOffset) * indexSize;
+    arena->bind();
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lods[lod].indexCount, indexType, (void*)offset, count,
+                                      arena->baseVertex(allocation));
+}
+
+void Mesh::interleave()
+{
+    // Cached vertices are uploaded from the mapped file as they are
+    if (streams.interleaved)
+        return;
+
+    if (streams.compact && !streams.derivedTangents)
+        CompactVertexFormat::interleave(streams, vertexData);
+    else if (streams.compact)
+        CompactNoTangentVertexFormat::interleave(streams, vertexData);
+    else if (!streams.derivedTangents)
+        StandardVertexFormat::interleave(streams, vertexData);
+    else
+        StandardNoTangentVertexFormat::interleave(streams, vertexData);
+    streams.interleaved = vertexData.empty() ? NULL : &vertexData[0];
+}
+
+unsigned int Mesh::drawVisible(const glm::mat4 &MVP, const glm::vec3 &eye)
+{
+    if (!ready)
+        return 0;
+    if (meshlets.empty())
+    {
+        draw(0);
+        return 0;
+    }
+
+    // Collect the index ranges of the visible meshlets
+    glm::vec4 planes[6];
+    Meshlets::frustumPlanes(MVP, planes);
+    drawCounts.clear();
+    drawOffsets.clear();
+    size_t base = arena->indexByteOffset(allocation);
+    unsigned int visible = 0;
+    unsigned int rangeEnd = 0;
+    for (size_t i = 0; i < meshlets.size(); i++)
+    {
+        const Meshlet &meshlet = meshlets[i];
+        if (!Meshlets::isVisible(meshlet, planes, eye))
+            continue;
+
+        visible++;
+        if (!drawCounts.empty() && rangeEnd == meshlet.indexOffset)
+        {
+            drawCounts.back() += meshlet.indexCount;
+        }
+        else
+        {
+            drawCounts.push_back(meshlet.indexCount);
+            drawOffsets.push_back((void*)(base + static_cast<size_t>(meshlet.indexOffset) * indexSize));
+        }
+        rangeEnd = meshlet.indexOffset + meshlet.indexCount;
+    }
+
+    // Draw them all in one call
+    if (!drawCounts.empty())
+    {
+        drawBaseVertices.assign(drawCounts.size(), arena->baseVertex(allocation));
+        arena->bind();
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, &drawCounts[0], indexType, &drawOffsets[0],
+                                      static_cast<GLsizei>(drawCounts.size()), &drawBaseVertices[0]);
+    }
+
+    return visible;
+}
+
+void Mesh::setupBuffers(const MeshStreams &streams)
+{
+    // Copy the interleaved vertices and the indices into the arena for the layout
+    indexSize = streams.indexSize;
+    indexType = streams.indexSize == sizeof(unsigned short) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    arena = &GeometryArena::get(streams.compact, !streams.derivedTangents, streams.indexSize);
+    allocation = arena->allocate(streams.interleaved, streams.vertexCount, streams.indices, streams.indexCount);
+}
+
+void Mesh::deleteBuffers()
+{
+    if (!ready)
+        return;
+
+    // Give the ranges back for other meshes to use
+    arena->free(allocation);
+    arena = NULL;
+    ready = false;
+}
+
+bool Mesh::loadObj(const char *path,
+                    std::vector<glm::vec3> &outVertices,
+                    std::vector<glm::vec2> &outUVs,
+                    std::vector<glm::vec3> &outNormals,
+                    std::vector<unsigned int> &outIndices)
+{
+    
+    printf("Loading file %s\n", path);
+    
+    // Parse the file from a memory mapping
+    ObjData obj;
+    if (!ObjLoader::load(path, obj))
+        return false;
+    
+    // Weld identical face corners into unique vertices and an index buffer
+    if (!ObjLoader::weld(obj, outVertices, outUVs, outNormals, outIndices))
+        return false;
+    
+    printf("Welded %u face corners into %u vertices\n",
+           static_cast<unsigned int>(outIndices.size()), static_cast<unsigned int>(outVertices.size()));
+    return true;
+}
+
+void Mesh::optimise(const char *path)
+{
+    CacheStats before = MeshOptimiser::analyseCache(indices, vertices.size());
+
+    // Triangle order for the post-transform cache, then cluster order for overdraw
+    MeshOptimiser::optimiseVertexCache(indices, vertices.size());
+    MeshOptimiser::optimiseOverdraw(indices, vertices);
+
+    // Vertex order for sequential fetches
+    std::vector<unsigned int> order = MeshOptimiser::optimiseVertexFetch(indices, vertices.size());
+    MeshOptimiser::remap(vertices, order);
+    MeshOptimiser::remap(uvs, order);
+    MeshOptimiser::remap(normals, order);
+
+    CacheStats after = MeshOptimiser::analyseCache(indices, vertices.size());
+    printf("Optimised %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+           path, before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+void Mesh::buildLods(const char *path, unsigned int count, bool optimise)
+{
+    // The full mesh is the first level
+    MeshLod full = { 0, static_cast<unsigned int>(indices.size()), 0.0f };
+    lods.assign(1, full);
+
+    // Each level halves the triangles of the one before it, stopping when the
+    // error gets too big or simplification stalls on seams and borders
+    const float maxError = 0.05f;
+    std::vector<unsigned int> lod(indices);
+    float error = 0.0f;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        size_t previousCount = lod.size();
+        error += MeshSimplifier::simplify(lod, vertices, lod.size() / 6 * 3, maxError);
+        if (lod.size() > previousCount * 9 / 10)
+            break;
+
+        if (optimise)
+            MeshOptimiser::optimiseVertexCache(lod, vertices.size());
+
+        MeshLod level = { static_cast<unsigned int>(indices.size()), static_cast<unsigned int>(lod.size()), error };
+        lods.push_back(level);
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        printf("Level of detail %u of %s: %u triangles, error %.4f\n",
+               i + 1, path, static_cast<unsigned int>(lod.size() / 3), error);
+    }
+}
+
+void Mesh::packCompact()
+{
+    packedUVs.resize(vertices.size());
+    packedNormals.resize(vertices.size());
+    packedTangents.resize(tangents.size());
+
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        packedUVs[i] = glm::packHalf2x16(uvs[i]);
+        packedNormals[i] = glm::packSnorm3x10_1x2(glm::vec4(glm::normalize(normals[i]), 0.0f));
+    }
+    for (unsigned int i = 0; i < tangents.size(); i++)
+        packedTangents[i] = glm::packSnorm3x10_1x2(tangents[i]);
+}
+
+std::shared_ptr<Mesh> MeshLoader::loadAsync(const char *path, const MeshOptions &options)
+{
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    std::string file(path);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loading++;
+    }
+
+    // Load on the thread pool and hand the mesh over to the upload queue
+    std::shared_ptr<Mesh> job = mesh;
+    ThreadPool::shared().enqueue([job, file, options]() mutable
+    {
+        bool res = job->load(file.c_str(), options);
+
+        if (!res)
+            printf("Unable to load mesh %s, models using it won't be drawn\n", file.c_str());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        loading--;
+        if (res)
+            uploads.push_back(std::move(job));
+    });
+
+    return mesh;
+}
+
+unsigned int MeshLoader::processUploads(double timeBudget)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned int uploaded = 0;
+
+    // Always upload at least one mesh so loading makes progress
+    while (true)
+    {
+        std::shared_ptr<Mesh> mesh;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (uploads.empty())
+                break;
+            mesh = uploads.front();
+            uploads.pop_front();
+        }
+
+        // Skip meshes every model has released while they were loading
+        if (mesh.use_count() == 1)
+            continue;
+
+        mesh->upload();
+        uploaded++;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= timeBudget)
+            break;
+    }
+
+    return uploaded;
+}
+
+unsigned int MeshLoader::pending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return loading + static_cast<unsigned int>(uploads.size());
+}
+
+std::shared_ptr<Mesh> MeshRegistry::acquire(const char *path, bool async, const MeshOptions &options)
+{
+    std::string key = canonicalPath(path) + "#" + std::to_string(options.flags());
+    std::map<std::string, Entry>::iterator it = meshes.find(key);
+    if (it != meshes.end())
+    {
+        printf("Sharing mesh %s\n", path);
+        it->second.users++;
+
+        // A blocking load has to wait for a mesh that is still loading in the background
+        while (!async && !it->second.mesh->isReady() && !it->second.mesh->hasFailed() && MeshLoader::pending() > 0)
+        {
+            if (MeshLoader::processUploads(0.0) == 0)
+                std::this_thread::yield();
+        }
+        return it->second.mesh;
+    }
+
+    Entry entry;
+    entry.users = 1;
+    if (async)
+    {
+        // Return straight away, the mesh is drawn once it has been uploaded
+        entry.mesh = MeshLoader::loadAsync(path, options);
+    }
+    else
+    {
+        // Load and upload the mesh before returning
+        entry.mesh = std::make_shared<Mesh>();
+        if (entry.mesh->load(path, options))
+            entry.mesh->upload();
+    }
+
+    meshes[key] = entry;
+    return entry.mesh;
+}
+
+void MeshRegistry::release(const std::shared_ptr<Mesh> &mesh)
+{
+    for (std::map<std::string, Entry>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+    {
+        if (it->second.mesh != mesh)
+            continue;
+
+        // Delete the buffers once the last user has gone
+        if (--it->second.users == 0)
+        {
+            mesh->deleteBuffers();
+            meshes.erase(it);
+        }
+        return;
+    }
+}
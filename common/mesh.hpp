@@ -0,0 +1,239 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "meshcache.hpp"
+#include "meshcodec.hpp"
+#include "geometryarena.hpp"
+
+// Optional processing applied when a mesh is built from an .obj file
+struct MeshOptions
+{
+    bool optimise = false;  // reorder for the post-transform vertex cache, overdraw and vertex fetch
+    bool compact = false;   // pack uvs, normals and tangents into 4 bytes each (24 instead of 48 bytes per vertex)
+    bool meshlets = false;  // split the full detail mesh into meshlets that can be culled individually
+    unsigned int lods = 0;  // number of simplified levels of detail to build, each with about half the triangles
+    bool derivedTangents = false;  // no tangents, for materials that build their tangent frames per pixel
+
+    // Bits of flags() that only pick the vertex layout
+    static const unsigned int compactFlag = 2u;
+    static const unsigned int derivedTangentsFlag = 8u;
+
+    // Bit flags stored in the binary cache so it is rebuilt when the options change
+    unsigned int flags() const
+    {
+        return (optimise ? 1u : 0u) | (compact ? compactFlag : 0u) | (meshlets ? 4u : 0u)
+            | (derivedTangents ? derivedTangentsFlag : 0u) | (lods << 4);
+    }
+};
+
+// Geometry of a model and where it lives in the shared GL buffers. Loading
+// the geometry makes no GL calls so it can run on any thread, it is then
+// copied into a geometry arena on the thread that owns the GL context.
+class Mesh
+{
+public:
+    // Mesh attributes (left empty when the mesh is uploaded from the binary cache)
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec4> tangents;  // w is the handedness of the bitangent
+    std::vector<unsigned int> indices;  // every level of detail, finest first
+
+    // Constructor
+    Mesh();
+
+    // Load the geometry from a packed mesh (.cmesh), the binary cache or the
+    // .obj file. Packed meshes were processed when they were made so only
+    // the compact option applies to them.
+    bool load(const char *path, const MeshOptions &options = MeshOptions());
+
+    // Write the loaded geometry as a packed mesh, before it is uploaded and
+    // only for the standard layout with tangents. options are the ones it was
+    // loaded with.
+    // (Not const: a mesh from the cache has its vertices split up again first.)
+    bool pack(const char *path, const MeshOptions &options);
+
+    // Read the full detail geometry back from the file the mesh was loaded
+    // from, for merging it into other meshes. Once the mesh has loaded that
+    // is its cache or packed mesh, so the .obj isn't parsed again. Makes no
+    // GL calls so it can run on any thread.
+    bool readGeometry(std::vector<glm::vec3> &outVertices, std::vector<glm::vec2> &outUVs,
+                      std::vector<glm::vec3> &outNormals, std::vector<unsigned int> &outIndices) const;
+
+    // Build the geometry from the attribute vectors filled in by the caller
+    // (tangents are generated), for meshes made in code rather than loaded
+    bool build(const char *name, const MeshOptions &options = MeshOptions());
+
+    // Create the GL buffers from the loaded geometry
+    void upload();
+
+    // True once the GL buffers exist
+    bool isReady() const { return ready; }
+
+    // True if the geometry couldn't be loaded, the mesh then never becomes ready
+    bool hasFailed() const { return failed; }
+
+    // Bounding volumes in the mesh's own space (valid once loaded)
+    const MeshBounds &bounds() const { return localBounds; }
+
+    // Number of levels of detail (1 when none were built)
+    unsigned int lodCount() const { return static_cast<unsigned int>(lods.size()); }
+
+    // Pick a level of detail from how many pixels one unit of the mesh covers
+    // on screen. A finer level is used as soon as the current one is off by
+    // more than maxPixelError, a coarser one only once it is well inside it,
+    // so instances near the switching distance don't pop back and forth.
+    unsigned int selectLod(float pixelsPerUnit, unsigned int current, float maxPixelError = 1.0f) const;
+
+    // Draw mesh
+    void draw(unsigned int lod = 0);
+
+    // Draw the mesh reading only the positions, for depth only passes
+    void drawPositions(unsigned int lod = 0);
+
+    // Draw several instances of the mesh in one call, for shaders that fetch
+    // per-instance data by gl_InstanceID
+    void drawInstanced(unsigned int count, unsigned int lod = 0);
+
+    // True when the vertices use the compact layout (valid once uploaded)
+    bool isCompact() const { return arena && arena->isCompact(); }
+
+    // True when the vertices carry tangents, otherwise the material has to
+    // derive its tangent frames (valid once uploaded)
+    bool hasTangents() const { return arena && arena->hasTangents(); }
+
+    // Bytes per vertex in the vertex buffer (valid once uploaded)
+    unsigned int vertexStride() const { return arena ? static_cast<unsigned int>(arena->vertexStride()) : 0; }
+
+    // Draw the full detail mesh without the meshlets that are outside the
+    // frustum or face away from the eye, merging neighbouring meshlets into
+    // one range. MVP and eye are relative to the mesh. Meshes without meshlets
+    // are drawn whole. Returns the number of meshlets drawn.
+    unsigned int drawVisible(const glm::mat4 &MVP, const glm::vec3 &eye);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+
+    // Loaded streams waiting to be uploaded
+    MeshCache cache;
+    MeshCodec packed;
+    MeshStreams streams;
+    std::vector<unsigned short> shortIndices;
+    std::vector<unsigned char> vertexData;  // interleaved in the vertex format of the layout
+    std::vector<unsigned int> packedUVs;
+    std::vector<unsigned int> packedNormals;
+    std::vector<unsigned int> packedTangents;
+    bool ready;
+    std::atomic<bool> failed;  // set on the loading thread
+
+    // File and options the mesh was loaded with, for reading it back
+    std::string sourcePath;
+    MeshOptions sourceOptions;
+
+    // Bounding volumes, their longest side is the size level of detail errors are relative to
+    MeshBounds localBounds;
+
+    // Levels of detail
+    std::vector<MeshLod> lods;
+
+    // Meshlets of the full detail mesh and the ranges of the visible ones
+    std::vector<Meshlet> meshlets;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void *> drawOffsets;
+    std::vector<GLint> drawBaseVertices;
+
+    // Ranges in the arena shared with the other meshes of the same layout
+    GeometryArena *arena;
+    GeometryArena::Handle allocation;
+
+    // Index buffer properties
+    unsigned int indexSize;
+    unsigned int indexType;
+
+    // Take the levels of detail, meshlets and bounds of streams that were
+    // loaded ready processed and interleave them
+    void useStreams(const MeshStreams &loaded);
+
+    // Optimise, add tangents, levels of detail, meshlets and bounds, and
+    // point the streams at the result
+    void process(const char *path, const MeshOptions &options);
+
+    // Reorder the triangles and vertices for the GPU
+    void optimise(const char *path);
+
+    // Pack the uvs, normals and any tangents into the compact layout
+    void packCompact();
+
+    // Interleave the streams into vertexData, unless they already are
+    void interleave();
+
+    // Fill the attribute vectors and indices from the interleaved streams
+    // of a mesh that was loaded from its cache or a packed mesh
+    void unpack();
+
+    // Append simplified copies of the full mesh to the index buffer
+    void buildLods(const char *path, unsigned int count, bool optimise);
+
+    // Load .obj file method
+    bool loadObj(const char *path,
+                 std::vector<glm::vec3> &inVertices,
+                 std::vector<glm::vec2> &inUVs,
+                 std::vector<glm::vec3> &inNormals,
+                 std::vector<unsigned int> &inIndices);
+
+    // Setup buffers
+    void setupBuffers(const MeshStreams &streams);
+};
+
+// Loads meshes on the thread pool and uploads them on the GL context thread
+class MeshLoader
+{
+public:
+    // Start loading a mesh in the background, the mesh is drawable once it has been uploaded
+    static std::shared_ptr<Mesh> loadAsync(const char *path, const MeshOptions &options = MeshOptions());
+
+    // Upload loaded meshes until the time budget (in seconds) is used up,
+    // call once per frame from the GL context thread. Returns the number uploaded.
+    static unsigned int processUploads(double timeBudget);
+
+    // Number of meshes still loading or waiting to be uploaded
+    static unsigned int pending();
+
+private:
+    static std::mutex mutex;
+    static std::deque<std::shared_ptr<Mesh> > uploads;
+    static unsigned int loading;
+};
+
+// Meshes shared between models, keyed by canonical path and options so each
+// file is loaded and uploaded once however many models use it
+class MeshRegistry
+{
+public:
+    // Get the mesh for a file, loading it if no model is using it yet
+    static std::shared_ptr<Mesh> acquire(const char *path, bool async, const MeshOptions &options = MeshOptions());
+
+    // Give up a model's use of a mesh, the GL buffers are deleted once the last user releases it
+    static void release(const std::shared_ptr<Mesh> &mesh);
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<Mesh> mesh;
+        unsigned int users;
+    };
+
+    static std::map<std::string, Entry> meshes;
+};
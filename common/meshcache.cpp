@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <atomic>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <common/meshcache.hpp>
+
+// Bump the version whenever the layout of the cache file changes
+static const char cacheMagic[4] = { 'M', 'E', 'S', 'H' };
+static const uint32_t cacheVersion = 8;
+
+// Cache file header, followed by the vertices interleaved in the vertex
+// format of the layout, the level of detail and meshlet tables and the
+// indices in that order
+struct MeshCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    uint32_t flags;
+    uint32_t compact;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    uint32_t derivedTangents;
+    MeshBounds bounds;
+};
+
+// Size and modification time of the source file
+static bool sourceStamp(const char *sourcePath, uint64_t &size, int64_t &time)
+{
+    struct stat info;
+    if (stat(sourcePath, &info) != 0)
+        return false;
+
+    size = static_cast<uint64_t>(info.st_size);
+    time = static_cast<int64_t>(info.st_mtime);
+    return true;
+}
+
+// Total size of the streams that follow the header
+static size_t streamsSize(const MeshStreams &streams)
+{
+    return streams.vertexCount * streams.vertexSize() + streams.lodCount * sizeof(MeshLod)
+        + streams.meshletCount * sizeof(Meshlet) + static_cast<size_t>(streams.indexCount) * streams.indexSize;
+}
+
+bool MeshStreams::hasValidRanges() const
+{
+    for (unsigned int i = 0; i < lodCount; i++)
+    {
+        if (static_cast<size_t>(lods[i].indexOffset) + lods[i].indexCount > indexCount)
+            return false;
+    }
+    for (unsigned int i = 0; i < meshletCount; i++)
+    {
+        if (static_cast<size_t>(meshlets[i].indexOffset) + meshlets[i].indexCount > indexCount)
+            return false;
+    }
+    return true;
+}
+
+// Move a file over another one in a single step
+static bool replaceFile(const char *from, const char *to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+std::string MeshCache::cachePath(const char *sourcePath, unsigned int flags)
+{
+    return std::string(sourcePath) + "." + std::to_string(flags) + ".meshcache";
+}
+
+bool MeshCache::open(const char *sourcePath, unsigned int flags)
+{
+    close();
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!sourceStamp(sourcePath, sourceSize, sourceTime))
+        return false;
+
+    std::string path = cachePath(sourcePath, flags);
+    if (!file.open(path.c_str()))
+        return false;
+
+    // Check the header matches this version and the current source file
+    const MeshCacheHeader *header = reinterpret_cast<const MeshCacheHeader *>(file.data());
+    if (file.size() < sizeof(MeshCacheHeader)
+        || memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) != 0
+        || header->version != cacheVersion
+        || header->sourceSize != sourceSize
+        || header->sourceTime != sourceTime
+        || header->flags != flags
+        || (header->indexSize != 2 && header->indexSize != 4))
+    {
+        close();
+        return false;
+    }
+
+    mapped.vertexCount = header->vertexCount;
+    mapped.indexCount = header->indexCount;
+    mapped.indexSize = header->indexSize;
+    mapped.compact = header->compact != 0;
+    mapped.lodCount = header->lodCount;
+    mapped.meshletCount = header->meshletCount;
+    mapped.derivedTangents = header->derivedTangents != 0;
+    if (header->lodCount == 0 || file.size() != sizeof(MeshCacheHeader) + streamsSize(mapped))
+    {
+        close();
+        return false;
+    }
+
+    // Point the streams at the mapped data
+    const char *p = file.data() + sizeof(MeshCacheHeader);
+    size_t vertexCount = header->vertexCount;
+    mapped.bounds = header->bounds;
+    mapped.interleaved = p;
+    p += vertexCount * mapped.vertexSize();
+    mapped.lods = reinterpret_cast<const MeshLod *>(p);
+    p += mapped.lodCount * sizeof(MeshLod);
+    mapped.meshlets = reinterpret_cast<const Meshlet *>(p);
+    p += mapped.meshletCount * sizeof(Meshlet);
+    mapped.indices = p;
+
+    // Don't let a damaged cache draw past its indices
+    if (!mapped.hasValidRanges())
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MeshCache::close()
+{
+    file.close();
+    mapped = MeshStreams();
+}
+
+bool MeshCache::write(const char *sourcePath, const MeshStreams &streams, unsigned int flags)
+{
+    if (streams.interleaved == NULL)
+        return false;
+
+    MeshCacheHeader header;
+    memset(static_cast<void *>(&header), 0, sizeof(header));
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.flags = flags;
+    if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+        return false;
+    header.vertexCount = streams.vertexCount;
+    header.indexCount = streams.indexCount;
+    header.indexSize = streams.indexSize;
+    header.compact = streams.compact ? 1 : 0;
+    header.lodCount = streams.lodCount;
+    header.meshletCount = streams.meshletCount;
+    header.derivedTangents = streams.derivedTangents ? 1 : 0;
+    header.bounds = streams.bounds;
+
+    // Each write gets its own temporary file, in case two threads write the same cache
+    static std::atomic<unsigned int> writes(0);
+    std::string path = cachePath(sourcePath, flags);
+    std::string temporary = path + "." + std::to_string(writes++) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    size_t vertexCount = streams.vertexCount;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(streams.interleaved, streams.vertexSize(), vertexCount, file) == vertexCount
+        && fwrite(streams.lods, sizeof(MeshLod), streams.lodCount, file) == streams.lodCount
+        && fwrite(streams.meshlets, sizeof(Meshlet), streams.meshletCount, file) == streams.meshletCount
+        && fwrite(streams.indices, streams.indexSize, streams.indexCount, file) == streams.indexCount;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && replaceFile(temporary.c_str(), path.c_str());
+
+    // Don't leave a partial cache behind
+    if (!ok)
+        remove(temporary.c_str());
+
+    return ok;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include <common/mappedfile.hpp>
+#include <common/bounds.hpp>
+
+// Range of one level of detail in the index buffer and how far its simplified
+// surface is from the full mesh (relative to the size of the mesh)
+struct MeshLod
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+};
+
+// Cluster of up to 64 vertices and 124 triangles of the full detail mesh,
+// stored as one index range with a bounding sphere and a cone around its
+// triangle normals for culling
+struct Meshlet
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    glm::vec3 centre;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;  // sine of the cone's half angle, 1 when the cone is too wide to cull with
+};
+
+// Final vertex attribute streams, indices and bounds of a mesh, ready to be
+// copied into GL buffers. Tangents carry the handedness of the bitangent in w.
+// The compact layout packs uvs into half floats and normals and tangents into
+// signed normalised 10_10_10_2 integers. Once the attributes have been
+// interleaved into the layout's vertex format, interleaved points at the
+// result; streams mapped from the cache only have that.
+struct MeshStreams
+{
+    const void *interleaved = NULL;      // vertexSize() bytes per vertex
+    const glm::vec3 *vertices = NULL;
+    const void *uvs = NULL;              // vec2, or 2 half floats when compact
+    const void *normals = NULL;          // vec3, or 10_10_10_2 when compact
+    const void *tangents = NULL;         // vec4, or 10_10_10_2 when compact
+    const void *indices = NULL;          // every level of detail, finest first
+    const MeshLod *lods = NULL;
+    const Meshlet *meshlets = NULL;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    unsigned int indexSize = 0;  // 2 or 4 bytes per index
+    unsigned int lodCount = 0;
+    unsigned int meshletCount = 0;
+    bool compact = false;
+    bool derivedTangents = false;  // no tangent stream, the material builds its frames per pixel
+    MeshBounds bounds = MeshBounds();
+
+    // Bytes per vertex of each stream
+    size_t uvSize() const { return compact ? 4 : sizeof(glm::vec2); }
+    size_t normalSize() const { return compact ? 4 : sizeof(glm::vec3); }
+    size_t tangentSize() const { return derivedTangents ? 0 : compact ? 4 : sizeof(glm::vec4); }
+    size_t vertexSize() const { return sizeof(glm::vec3) + uvSize() + normalSize() + tangentSize(); }
+
+    // True if every level of detail and meshlet lies within the indices
+    bool hasValidRanges() const;
+};
+
+// Binary mesh cache stored next to the source .obj file, one per set of
+// option flags so meshes loaded from the same file with different options
+// keep their own. The vertices are stored interleaved so they are uploaded
+// straight from the mapping. The cache records the size and modification time
+// of the source file, and is ignored once either changes.
+class MeshCache
+{
+public:
+    // Map the cache for a source file, returns false if there isn't an up to date one
+    bool open(const char *sourcePath, unsigned int flags);
+
+    // Streams pointing into the mapped cache file (valid until the cache is closed)
+    const MeshStreams &streams() const { return mapped; }
+
+    // Unmap the cache file
+    void close();
+
+    // Write the cache for a source file. It is written to a temporary file
+    // and renamed into place, so a cache another mesh has mapped is never
+    // truncated under it.
+    static bool write(const char *sourcePath, const MeshStreams &streams, unsigned int flags);
+
+    // Path of the cache file for a source file and option flags
+    static std::string cachePath(const char *sourcePath, unsigned int flags);
+
+private:
+    MappedFile file;
+    MeshStreams mapped;
+};
@@ -0,0 +1,469 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+#include <common/meshcodec.hpp>
+#include <common/mappedfile.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHCODEC_SSE2
+#endif
+
+// Bump the version whenever the layout of the file changes
+static const char packedMagic[4] = { 'C', 'M', 'S', 'H' };
+static const uint32_t packedVersion = 1;
+
+// Packed mesh header, followed by the quantised positions and uvs, the
+// octahedral normals and tangents, the level of detail and meshlet tables
+// and the encoded indices in that order
+struct PackedMeshHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexBytes;  // size of the encoded indices
+    uint32_t lodCount;
+    uint32_t meshletCount;
+    float positionOffset[3];
+    float positionScale[3];
+    float uvOffset[2];
+    float uvScale[2];
+    MeshBounds bounds;
+};
+
+// Largest quantised value and octahedral component
+static const float quantisedMax = 65535.0f;
+static const float octahedralMax = 32767.0f;
+
+// Offset and scale that map the range of each component onto 0 to 65535
+static void quantisation(const float *values, size_t count, unsigned int components, float *offset, float *scale)
+{
+    for (unsigned int c = 0; c < components; c++)
+    {
+        float low = count > 0 ? values[c] : 0.0f, high = low;
+        for (size_t i = c; i < count * components; i += components)
+        {
+            low = glm::min(low, values[i]);
+            high = glm::max(high, values[i]);
+        }
+        offset[c] = low;
+        scale[c] = (high - low) / quantisedMax;
+    }
+}
+
+static void quantise(const float *values, size_t count, unsigned int components, const float *offset,
+                     const float *scale, std::vector<uint16_t> &out)
+{
+    out.resize(count * components);
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        unsigned int c = static_cast<unsigned int>(i % components);
+        float q = scale[c] > 0.0f ? (values[i] - offset[c]) / scale[c] : 0.0f;
+        out[i] = static_cast<uint16_t>(glm::clamp(q + 0.5f, 0.0f, quantisedMax));
+    }
+}
+
+// Unit vector folded onto the octahedron and flattened into a square
+static glm::vec2 octahedralEncode(glm::vec3 v)
+{
+    v /= glm::max(std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z), 1e-20f);
+    glm::vec2 p(v.x, v.y);
+    if (v.z < 0.0f)
+    {
+        p.x = (1.0f - std::fabs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f);
+        p.y = (1.0f - std::fabs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return p;
+}
+
+static int16_t octahedralComponent(float value)
+{
+    return static_cast<int16_t>(std::floor(glm::clamp(value, -1.0f, 1.0f) * octahedralMax + 0.5f));
+}
+
+// Zigzag delta from the previous index as a variable length integer, 7 bits per byte
+static void encodeIndices(const void *indices, unsigned int count, unsigned int indexSize, std::vector<unsigned char> &out)
+{
+    uint32_t previous = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t index = indexSize == 2 ? static_cast<const uint16_t *>(indices)[i] : static_cast<const uint32_t *>(indices)[i];
+        int32_t delta = static_cast<int32_t>(index - previous);
+        uint32_t code = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+        while (code >= 0x80)
+        {
+            out.push_back(static_cast<unsigned char>(code | 0x80));
+            code >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(code));
+        previous = index;
+    }
+}
+
+// Undo encodeIndices, returns false if the data runs out or an index is out of range
+template <typename T>
+static bool decodeIndices(const unsigned char *data, size_t size, unsigned int count, unsigned int vertexCount, T *out)
+{
+    const unsigned char *end = data + size;
+    uint32_t previous = 0, largest = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // Most deltas fit in one byte
+        uint32_t code = 0;
+        unsigned int shift = 0;
+        while (true)
+        {
+            if (data == end || shift > 28)
+                return false;
+            unsigned char byte = *data++;
+            code |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80)
+                break;
+            shift += 7;
+        }
+        previous += (code >> 1) ^ (0u - (code & 1));
+        largest = glm::max(largest, previous);
+        out[i] = static_cast<T>(previous);
+    }
+    return count == 0 || largest < vertexCount;
+}
+
+// Quantised values back to floats, components values per vertex
+static void dequantise(const uint16_t *in, size_t count, unsigned int components, const float *offset,
+                       const float *scale, float *out)
+{
+    size_t i = 0;
+
+#ifdef MESHCODEC_SSE2
+    // Twelve values at a time, a whole number of vertices with two or three components
+    __m128 scales[3], offsets[3];
+    for (unsigned int k = 0; k < 3; k++)
+    {
+        unsigned int c = 4 * k;
+        scales[k] = _mm_setr_ps(scale[c % components], scale[(c + 1) % components], scale[(c + 2) % components],
+                                scale[(c + 3) % components]);
+        offsets[k] = _mm_setr_ps(offset[c % components], offset[(c + 1) % components],
+                                 offset[(c + 2) % components], offset[(c + 3) % components]);
+    }
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 12 <= count * components; i += 12)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i + 8));
+        __m128 v0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(a, zero));
+        __m128 v1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(a, zero));
+        __m128 v2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(v0, scales[0]), offsets[0]));
+        _mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_mul_ps(v1, scales[1]), offsets[1]));
+        _mm_storeu_ps(out + i + 8, _mm_add_ps(_mm_mul_ps(v2, scales[2]), offsets[2]));
+    }
+#endif
+
+    // Remaining values
+    for (; i < count * components; i++)
+    {
+        unsigned int c = static_cast<unsigned int>(i % components);
+        out[i] = static_cast<float>(in[i]) * scale[c] + offset[c];
+    }
+}
+
+// Signed normalised 10-bit component of the compact layout, rounded to
+// nearest even like the vector conversion
+static uint32_t packComponent(float value, float range, uint32_t mask)
+{
+    return static_cast<uint32_t>(static_cast<int32_t>(std::nearbyint(value * range))) & mask;
+}
+
+// Unit vector from an octahedral pair, tangents take their handedness from
+// the lowest bit of x
+static glm::vec4 octahedralDecode(int16_t qx, int16_t qy, bool tangent)
+{
+    float x = static_cast<float>(qx) * (1.0f / octahedralMax);
+    float y = static_cast<float>(qy) * (1.0f / octahedralMax);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = glm::max(-z, 0.0f);
+    x -= x >= 0.0f ? t : -t;
+    y -= y >= 0.0f ? t : -t;
+    float scale = 1.0f / std::sqrt(x * x + y * y + z * z);
+    float w = tangent ? ((qx & 1) ? -1.0f : 1.0f) : 0.0f;
+    return glm::vec4(x * scale, y * scale, z * scale, w);
+}
+
+// Octahedral pairs back to vec3 normals, vec4 tangents or 10_10_10_2 words
+static void decodeDirections(const int16_t *in, size_t count, bool tangent, bool compact, unsigned char *out)
+{
+    float *floats = reinterpret_cast<float *>(out);
+    uint32_t *words = reinterpret_cast<uint32_t *>(out);
+    size_t stride = tangent ? 4 : 3;
+    size_t i = 0;
+
+#ifdef MESHCODEC_SSE2
+    // Four vectors at a time. The vec3 normals are stored four floats at a
+    // time over the start of the next normal, so stop one early for them.
+    __m128 signBit = _mm_set1_ps(-0.0f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 zeroFloat = _mm_setzero_ps();
+    __m128 toUnit = _mm_set1_ps(1.0f / octahedralMax);
+    size_t last = !compact && !tangent ? 5 : 4;
+    for (; i + last <= count; i += 4)
+    {
+        // Sign extend the 16-bit pairs
+        __m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i));
+        __m128i qx = _mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16);
+        __m128i qy = _mm_srai_epi32(pairs, 16);
+
+        // Unfold the octahedron
+        __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(qx), toUnit);
+        __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(qy), toUnit);
+        __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, x)), _mm_andnot_ps(signBit, y));
+        __m128 t = _mm_max_ps(_mm_sub_ps(zeroFloat, z), zeroFloat);
+        x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(x, signBit)));
+        y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(y, signBit)));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 scale = _mm_div_ps(one, length);
+        x = _mm_mul_ps(x, scale);
+        y = _mm_mul_ps(y, scale);
+        z = _mm_mul_ps(z, scale);
+
+        // Handedness from the lowest bit of x
+        __m128 w = zeroFloat;
+        if (tangent)
+        {
+            __m128i odd = _mm_cmpeq_epi32(_mm_and_si128(qx, _mm_set1_epi32(1)), _mm_set1_epi32(1));
+            w = _mm_or_ps(one, _mm_and_ps(_mm_castsi128_ps(odd), signBit));
+        }
+
+        if (compact)
+        {
+            __m128i mask = _mm_set1_epi32(0x3ff);
+            __m128 range = _mm_set1_ps(511.0f);
+            __m128i px = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(x, range)), mask);
+            __m128i py = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(y, range)), mask);
+            __m128i pz = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(z, range)), mask);
+            __m128i pw = _mm_and_si128(_mm_cvtps_epi32(w), _mm_set1_epi32(3));
+            __m128i packed = _mm_or_si128(_mm_or_si128(px, _mm_slli_epi32(py, 10)),
+                                          _mm_or_si128(_mm_slli_epi32(pz, 20), _mm_slli_epi32(pw, 30)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(words + i), packed);
+        }
+        else
+        {
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(floats + stride * i, x);
+            _mm_storeu_ps(floats + stride * (i + 1), y);
+            _mm_storeu_ps(floats + stride * (i + 2), z);
+            _mm_storeu_ps(floats + stride * (i + 3), w);
+        }
+    }
+#endif
+
+    // Remaining vectors
+    for (; i < count; i++)
+    {
+        glm::vec4 v = octahedralDecode(in[2 * i], in[2 * i + 1], tangent);
+        if (compact)
+        {
+            words[i] = packComponent(v.x, 511.0f, 0x3ff) | packComponent(v.y, 511.0f, 0x3ff) << 10
+                | packComponent(v.z, 511.0f, 0x3ff) << 20 | packComponent(v.w, 1.0f, 3) << 30;
+        }
+        else
+        {
+            for (size_t c = 0; c < stride; c++)
+                floats[stride * i + c] = v[static_cast<int>(c)];
+        }
+    }
+}
+
+bool MeshCodec::isPacked(const char *path)
+{
+    size_t length = strlen(path);
+    return length >= 6 && strcmp(path + length - 6, ".cmesh") == 0;
+}
+
+bool MeshCodec::open(const char *path, bool compact)
+{
+    close();
+
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    // Check the header and that the file holds everything it lists
+    PackedMeshHeader header;
+    if (file.size() < sizeof(header))
+        return false;
+    memcpy(&header, file.data(), sizeof(header));
+    size_t vertexCount = header.vertexCount;
+    size_t expected = sizeof(header) + vertexCount * 9 * sizeof(uint16_t) + header.lodCount * sizeof(MeshLod)
+        + header.meshletCount * sizeof(Meshlet) + header.indexBytes;
+    if (memcmp(header.magic, packedMagic, sizeof(packedMagic)) != 0 || header.version != packedVersion
+        || header.lodCount == 0 || file.size() != expected)
+    {
+        printf("%s isn't a valid packed mesh\n", path);
+        return false;
+    }
+
+    decoded.vertexCount = header.vertexCount;
+    decoded.indexCount = header.indexCount;
+    decoded.indexSize = vertexCount <= 65536 ? 2 : 4;
+    decoded.compact = compact;
+    decoded.bounds = header.bounds;
+    builtFlags = header.flags;
+
+    const char *p = file.data() + sizeof(header);
+    const uint16_t *quantisedVertices = reinterpret_cast<const uint16_t *>(p);
+    const uint16_t *quantisedUVs = quantisedVertices + 3 * vertexCount;
+    const int16_t *octahedralNormals = reinterpret_cast<const int16_t *>(quantisedUVs + 2 * vertexCount);
+    const int16_t *octahedralTangents = octahedralNormals + 2 * vertexCount;
+    p += vertexCount * 9 * sizeof(uint16_t);
+
+    // Tables are copied as they are, they may not be aligned in the file
+    lods.resize(header.lodCount);
+    memcpy(&lods[0], p, lods.size() * sizeof(MeshLod));
+    p += lods.size() * sizeof(MeshLod);
+    meshlets.resize(header.meshletCount);
+    if (!meshlets.empty())
+        memcpy(&meshlets[0], p, meshlets.size() * sizeof(Meshlet));
+    p += meshlets.size() * sizeof(Meshlet);
+    decoded.lods = lods.data();
+    decoded.lodCount = header.lodCount;
+    decoded.meshlets = meshlets.empty() ? NULL : meshlets.data();
+    decoded.meshletCount = header.meshletCount;
+    if (!decoded.hasValidRanges())
+    {
+        printf("%s isn't a valid packed mesh\n", path);
+        close();
+        return false;
+    }
+
+    // Indices
+    indices.resize(static_cast<size_t>(header.indexCount) * decoded.indexSize);
+    const unsigned char *encoded = reinterpret_cast<const unsigned char *>(p);
+    bool valid = decoded.indexSize == 2
+        ? decodeIndices(encoded, header.indexBytes, header.indexCount, header.vertexCount, reinterpret_cast<uint16_t *>(indices.data()))
+        : decodeIndices(encoded, header.indexBytes, header.indexCount, header.vertexCount, reinterpret_cast<uint32_t *>(indices.data()));
+    if (!valid)
+    {
+        printf("%s isn't a valid packed mesh\n", path);
+        close();
+        return false;
+    }
+
+    // Positions
+    vertices.resize(vertexCount);
+    dequantise(quantisedVertices, vertexCount, 3, header.positionOffset, header.positionScale,
+               reinterpret_cast<float *>(vertices.data()));
+
+    // Uvs, converted to half floats for the compact layout
+    uvs.resize(vertexCount * decoded.uvSize());
+    if (compact)
+    {
+        std::vector<glm::vec2> values(vertexCount);
+        dequantise(quantisedUVs, vertexCount, 2, header.uvOffset, header.uvScale, reinterpret_cast<float *>(values.data()));
+        uint32_t *packed = reinterpret_cast<uint32_t *>(uvs.data());
+        for (size_t i = 0; i < vertexCount; i++)
+            packed[i] = glm::packHalf2x16(values[i]);
+    }
+    else
+    {
+        dequantise(quantisedUVs, vertexCount, 2, header.uvOffset, header.uvScale, reinterpret_cast<float *>(uvs.data()));
+    }
+
+    // Normals and tangents
+    normals.resize(vertexCount * decoded.normalSize());
+    tangents.resize(vertexCount * decoded.tangentSize());
+    decodeDirections(octahedralNormals, vertexCount, false, compact, normals.data());
+    decodeDirections(octahedralTangents, vertexCount, true, compact, tangents.data());
+
+    decoded.vertices = vertices.data();
+    decoded.uvs = uvs.data();
+    decoded.normals = normals.data();
+    decoded.tangents = tangents.data();
+    decoded.indices = indices.data();
+    return true;
+}
+
+void MeshCodec::close()
+{
+    decoded = MeshStreams();
+    builtFlags = 0;
+    std::vector<glm::vec3>().swap(vertices);
+    std::vector<unsigned char>().swap(uvs);
+    std::vector<unsigned char>().swap(normals);
+    std::vector<unsigned char>().swap(tangents);
+    std::vector<unsigned char>().swap(indices);
+    std::vector<MeshLod>().swap(lods);
+    std::vector<Meshlet>().swap(meshlets);
+}
+
+bool MeshCodec::write(const char *path, const MeshStreams &streams, unsigned int flags)
+{
+    if (streams.compact || streams.vertexCount == 0 || streams.lodCount == 0)
+        return false;
+
+    PackedMeshHeader header;
+    memset(static_cast<void *>(&header), 0, sizeof(header));
+    memcpy(header.magic, packedMagic, sizeof(packedMagic));
+    header.version = packedVersion;
+    header.flags = flags;
+    header.vertexCount = streams.vertexCount;
+    header.indexCount = streams.indexCount;
+    header.lodCount = streams.lodCount;
+    header.meshletCount = streams.meshletCount;
+    header.bounds = streams.bounds;
+
+    // Quantise positions and uvs within their ranges
+    size_t vertexCount = streams.vertexCount;
+    const float *positions = reinterpret_cast<const float *>(streams.vertices);
+    const float *uvValues = static_cast<const float *>(streams.uvs);
+    std::vector<uint16_t> quantisedVertices, quantisedUVs;
+    quantisation(positions, vertexCount, 3, header.positionOffset, header.positionScale);
+    quantisation(uvValues, vertexCount, 2, header.uvOffset, header.uvScale);
+    quantise(positions, vertexCount, 3, header.positionOffset, header.positionScale, quantisedVertices);
+    quantise(uvValues, vertexCount, 2, header.uvOffset, header.uvScale, quantisedUVs);
+
+    // Normals and tangents on the octahedron, the tangent's handedness replaces the lowest bit of x
+    const glm::vec3 *normalValues = static_cast<const glm::vec3 *>(streams.normals);
+    const glm::vec4 *tangentValues = static_cast<const glm::vec4 *>(streams.tangents);
+    std::vector<int16_t> octahedralNormals(2 * vertexCount), octahedralTangents(2 * vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        glm::vec2 normal = octahedralEncode(normalValues[i]);
+        octahedralNormals[2 * i] = octahedralComponent(normal.x);
+        octahedralNormals[2 * i + 1] = octahedralComponent(normal.y);
+
+        glm::vec2 tangent = octahedralEncode(glm::vec3(tangentValues[i]));
+        int16_t x = octahedralComponent(tangent.x);
+        octahedralTangents[2 * i] = static_cast<int16_t>((x & ~1) | (tangentValues[i].w < 0.0f ? 1 : 0));
+        octahedralTangents[2 * i + 1] = octahedralComponent(tangent.y);
+    }
+
+    std::vector<unsigned char> encodedIndices;
+    encodeIndices(streams.indices, streams.indexCount, streams.indexSize, encodedIndices);
+    header.indexBytes = static_cast<uint32_t>(encodedIndices.size());
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(quantisedVertices.data(), sizeof(uint16_t), quantisedVertices.size(), file) == quantisedVertices.size()
+        && fwrite(quantisedUVs.data(), sizeof(uint16_t), quantisedUVs.size(), file) == quantisedUVs.size()
+        && fwrite(octahedralNormals.data(), sizeof(int16_t), octahedralNormals.size(), file) == octahedralNormals.size()
+        && fwrite(octahedralTangents.data(), sizeof(int16_t), octahedralTangents.size(), file) == octahedralTangents.size()
+        && fwrite(streams.lods, sizeof(MeshLod), streams.lodCount, file) == streams.lodCount
+        && fwrite(streams.meshlets, sizeof(Meshlet), streams.meshletCount, file) == streams.meshletCount
+        && fwrite(encodedIndices.data(), 1, encodedIndices.size(), file) == encodedIndices.size();
+    ok = fclose(file) == 0 && ok;
+
+    // Don't leave a partial file behind
+    if (!ok)
+        remove(path);
+
+    return ok;
+}
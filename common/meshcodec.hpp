@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include <common/meshcache.hpp>
+
+// Compressed mesh file (.cmesh) for shipping processed meshes in place of
+// .obj files. Positions and uvs are quantised to 16 bits within their
+// bounds, normals and tangents are stored as 16-bit octahedral pairs (with
+// the handedness of the bitangent in the lowest bit of the tangent) and the
+// indices are zigzag coded deltas written as variable length integers.
+// Levels of detail, meshlets and bounds are kept as they are, so a packed
+// mesh is drawn exactly like the mesh it was made from.
+class MeshCodec
+{
+public:
+    // Decode a file into the standard or the compact vertex layout, returns
+    // false if the file can't be read or isn't a valid packed mesh
+    bool open(const char *path, bool compact);
+
+    // Decoded streams (valid until the codec is closed)
+    const MeshStreams &streams() const { return decoded; }
+
+    // Flags of the options the mesh was processed with
+    unsigned int flags() const { return builtFlags; }
+
+    // Free the decoded streams
+    void close();
+
+    // Compress streams in the standard layout into a file, flags are the
+    // options they were processed with
+    static bool write(const char *path, const MeshStreams &streams, unsigned int flags);
+
+    // True if a path names a packed mesh rather than an .obj file
+    static bool isPacked(const char *path);
+
+private:
+    MeshStreams decoded;
+    unsigned int builtFlags = 0;
+
+    // Decoded attributes, in the layout the streams say
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned char> uvs;
+    std::vector<unsigned char> normals;
+    std::vector<unsigned char> tangents;
+    std::vector<unsigned char> indices;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+};
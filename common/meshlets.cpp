@@ -0,0 +1,155 @@
+#include <cmath>
+#include <algorithm>
+
+#include <common/meshlets.hpp>
+
+// Lowest cosine allowed between a triangle's normal and the average normal of
+// the meshlet it is added to
+static const float maxConeSpread = 0.5f;
+
+// Bounding sphere and normal cone of the triangles in a meshlet
+static void meshletBounds(const std::vector<unsigned int> &indices, const std::vector<glm::vec3> &vertices,
+                          Meshlet &meshlet)
+{
+    unsigned int begin = meshlet.indexOffset, end = meshlet.indexOffset + meshlet.indexCount;
+
+    // Sphere around the centre of the bounding box
+    glm::vec3 boundsMin = vertices[indices[begin]], boundsMax = boundsMin;
+    for (unsigned int i = begin + 1; i < end; i++)
+    {
+        boundsMin = glm::min(boundsMin, vertices[indices[i]]);
+        boundsMax = glm::max(boundsMax, vertices[indices[i]]);
+    }
+    meshlet.centre = 0.5f * (boundsMin + boundsMax);
+    float radius = 0.0f;
+    for (unsigned int i = begin; i < end; i++)
+        radius = std::max(radius, glm::length(vertices[indices[i]] - meshlet.centre));
+    meshlet.radius = radius;
+
+    // Cone axis along the average triangle normal
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.indexCount / 3);
+    glm::vec3 axis(0.0f);
+    for (unsigned int i = begin; i < end; i += 3)
+    {
+        const glm::vec3 &a = vertices[indices[i]];
+        const glm::vec3 &b = vertices[indices[i + 1]];
+        const glm::vec3 &c = vertices[indices[i + 2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (axisLength == 0.0f)
+        return;
+    axis /= axisLength;
+
+    // The cone has to hold every normal, wider than a hemisphere can't be culled
+    float minDot = 1.0f;
+    for (size_t i = 0; i < normals.size(); i++)
+        minDot = std::min(minDot, glm::dot(axis, normals[i]));
+
+    meshlet.coneAxis = axis;
+    if (minDot > 0.0f)
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+std::vector<Meshlet> Meshlets::build(const std::vector<unsigned int> &indices, size_t indexCount,
+                                     const std::vector<glm::vec3> &vertices,
+                                     unsigned int maxVertices, unsigned int maxTriangles)
+{
+    std::vector<Meshlet> meshlets;
+
+    // Which meshlet last used each vertex
+    const unsigned int none = ~0u;
+    std::vector<unsigned int> usedBy(vertices.size(), none);
+
+    Meshlet current = Meshlet();
+    unsigned int vertexCount = 0;
+    glm::vec3 normalSum(0.0f);
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        unsigned int meshletIndex = static_cast<unsigned int>(meshlets.size());
+        unsigned int newVertices = 0;
+        for (int k = 0; k < 3; k++)
+            if (usedBy[indices[i + k]] != meshletIndex)
+                newVertices++;
+
+        const glm::vec3 &a = vertices[indices[i]];
+        glm::vec3 normal = glm::cross(vertices[indices[i + 1]] - a, vertices[indices[i + 2]] - a);
+        float length = glm::length(normal);
+        if (length > 0.0f)
+            normal /= length;
+
+        // Start a new meshlet when this triangle doesn't fit, or when it faces
+        // so far from the others that the normal cone would be too wide to cull
+        float sumLength = glm::length(normalSum);
+        bool facesAway = sumLength > 0.0f && glm::dot(normalSum / sumLength, normal) < maxConeSpread;
+        if (current.indexCount > 0
+            && (vertexCount + newVertices > maxVertices || current.indexCount / 3 + 1 > maxTriangles || facesAway))
+        {
+            meshletBounds(indices, vertices, current);
+            meshlets.push_back(current);
+            current = Meshlet();
+            current.indexOffset = static_cast<unsigned int>(i);
+            vertexCount = 0;
+            normalSum = glm::vec3(0.0f);
+            meshletIndex++;
+        }
+        normalSum += normal;
+
+        for (int k = 0; k < 3; k++)
+        {
+            if (usedBy[indices[i + k]] != meshletIndex)
+            {
+                usedBy[indices[i + k]] = meshletIndex;
+                vertexCount++;
+            }
+        }
+        current.indexCount += 3;
+    }
+
+    if (current.indexCount > 0)
+    {
+        meshletBounds(indices, vertices, current);
+        meshlets.push_back(current);
+    }
+
+    return meshlets;
+}
+
+void Meshlets::frustumPlanes(const glm::mat4 &MVP, glm::vec4 planes[6])
+{
+    // Rows of the matrix added to and subtracted from the w row
+    glm::vec4 x(MVP[0][0], MVP[1][0], MVP[2][0], MVP[3][0]);
+    glm::vec4 y(MVP[0][1], MVP[1][1], MVP[2][1], MVP[3][1]);
+    glm::vec4 z(MVP[0][2], MVP[1][2], MVP[2][2], MVP[3][2]);
+    glm::vec4 w(MVP[0][3], MVP[1][3], MVP[2][3], MVP[3][3]);
+
+    planes[0] = w + x;
+    planes[1] = w - x;
+    planes[2] = w + y;
+    planes[3] = w - y;
+    planes[4] = w + z;
+    planes[5] = w - z;
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+bool Meshlets::isVisible(const Meshlet &meshlet, const glm::vec4 planes[6], const glm::vec3 &eye)
+{
+    // Outside any of the frustum planes
+    for (int i = 0; i < 6; i++)
+        if (glm::dot(glm::vec3(planes[i]), meshlet.centre) + planes[i].w < -meshlet.radius)
+            return false;
+
+    // Every triangle faces away from the eye
+    glm::vec3 toCentre = meshlet.centre - eye;
+    return glm::dot(toCentre, meshlet.coneAxis) < glm::length(toCentre) * meshlet.coneCutoff + meshlet.radius;
+}
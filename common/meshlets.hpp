@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "meshcache.hpp"
+
+// Splits meshes into meshlets and culls them against the camera
+class Meshlets
+{
+public:
+    // Split the first indexCount indices into meshlets of consecutive
+    // triangles, starting a new one whenever the next triangle would take it
+    // past maxVertices unique vertices or maxTriangles triangles, or would
+    // widen its normal cone too far. The triangle order is kept so the index
+    // buffer stays cache optimised.
+    static std::vector<Meshlet> build(const std::vector<unsigned int> &indices, size_t indexCount,
+                                      const std::vector<glm::vec3> &vertices,
+                                      unsigned int maxVertices = 64, unsigned int maxTriangles = 124);
+
+    // Normalised left, right, bottom, top, near and far planes of a
+    // projection matrix, in the space the matrix transforms from
+    static void frustumPlanes(const glm::mat4 &MVP, glm::vec4 planes[6]);
+
+    // True unless the meshlet is outside the frustum or all of its triangles
+    // face away from the eye. The planes and eye are in the mesh's space, the
+    // cone test assumes the mesh is scaled uniformly.
+    static bool isVisible(const Meshlet &meshlet, const glm::vec4 planes[6], const glm::vec3 &eye);
+};
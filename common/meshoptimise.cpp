@@ -0,0 +1,262 @@
+#include <cmath>
+#include <algorithm>
+
+#include <common/meshoptimise.hpp>
+
+// Size of the LRU cache modelled when scoring vertices
+static const int scoringCacheSize = 32;
+
+// Score of a vertex from its position in the LRU cache and the number of
+// triangles still to be drawn that use it
+static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // The vertices of the last triangle get a fixed score so that the
+        // next triangle doesn't just reuse the same edge
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - (cachePosition - 3) / float(scoringCacheSize - 3), 1.5f);
+    }
+
+    // Favour vertices with few triangles left so they aren't left stranded
+    return score + 2.0f / std::sqrt(float(remainingTriangles));
+}
+
+CacheStats MeshOptimiser::analyseCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                       unsigned int cacheSize)
+{
+    // Time stamp of when each vertex entered the cache
+    std::vector<unsigned int> entered(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    unsigned int misses = 0;
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (time - entered[v] > cacheSize)
+        {
+            entered[v] = time++;
+            misses++;
+        }
+    }
+
+    CacheStats stats;
+    stats.acmr = indices.empty() ? 0.0f : misses / float(indices.size() / 3);
+    stats.atvr = vertexCount == 0 ? 0.0f : misses / float(vertexCount);
+    return stats;
+}
+
+void MeshOptimiser::optimiseVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // List the triangles that use each vertex
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        remaining[indices[i]]++;
+
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    // Initial scores
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    std::vector<unsigned int> cache, newCache;
+    cache.reserve(scoringCacheSize + 3);
+    newCache.reserve(scoringCacheSize + 3);
+
+    size_t nextUnemitted = 0;
+    int best = 0;
+    while (best >= 0)
+    {
+        // Emit the best triangle
+        emitted[best] = true;
+        const unsigned int *triangle = &indices[3 * best];
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // Remove it from its vertices' triangle lists
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            unsigned int *begin = &adjacency[offsets[v]];
+            unsigned int *end = begin + remaining[v];
+            *std::find(begin, end, static_cast<unsigned int>(best)) = *(end - 1);
+            remaining[v]--;
+        }
+
+        // Move the triangle's vertices to the front of the LRU cache
+        newCache.assign(triangle, triangle + 3);
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            unsigned int v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.push_back(v);
+        }
+
+        // Update the scores of the cached vertices and their triangles
+        best = -1;
+        float bestScore = -1e30f;
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            int position = i < static_cast<size_t>(scoringCacheSize) ? static_cast<int>(i) : -1;
+            cachePosition[v] = position;
+
+            float newScore = vertexScore(position, remaining[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+
+            for (unsigned int j = offsets[v]; j < offsets[v] + remaining[v]; j++)
+            {
+                unsigned int t = adjacency[j];
+                triangleScore[t] += delta;
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = static_cast<int>(t);
+                }
+            }
+        }
+        if (newCache.size() > static_cast<size_t>(scoringCacheSize))
+            newCache.resize(scoringCacheSize);
+        cache.swap(newCache);
+
+        // Nothing in the cache can be drawn, start again from the next unused triangle
+        if (best < 0)
+        {
+            while (nextUnemitted < triangleCount && emitted[nextUnemitted])
+                nextUnemitted++;
+            if (nextUnemitted < triangleCount)
+                best = static_cast<int>(nextUnemitted);
+        }
+    }
+
+    indices.swap(result);
+}
+
+void MeshOptimiser::optimiseOverdraw(std::vector<unsigned int> &indices, const std::vector<glm::vec3> &vertices,
+                                     unsigned int cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Start a new cluster wherever all three vertices of a triangle miss the cache
+    std::vector<unsigned int> clusterStarts;
+    std::vector<unsigned int> entered(vertices.size(), 0);
+    unsigned int time = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[3 * t + k];
+            if (time - entered[v] > cacheSize)
+            {
+                entered[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusterStarts.push_back(static_cast<unsigned int>(t));
+    }
+    clusterStarts.push_back(static_cast<unsigned int>(triangleCount));
+
+    // Centre of the whole mesh
+    glm::vec3 meshCentre(0.0f);
+    for (size_t i = 0; i < vertices.size(); i++)
+        meshCentre += vertices[i];
+    meshCentre /= float(vertices.size());
+
+    // Sort key of each cluster: how far its area weighted centre lies along its average normal
+    size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<float> sortKey(clusterCount);
+    std::vector<unsigned int> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        glm::vec3 centre(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[3 * t]];
+            const glm::vec3 &b = vertices[indices[3 * t + 1]];
+            const glm::vec3 &d = vertices[indices[3 * t + 2]];
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(n);
+            centre += (a + b + d) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+        if (area > 0.0f)
+            centre /= area;
+        float length = glm::length(normal);
+        if (length > 0.0f)
+            normal /= length;
+
+        sortKey[c] = glm::dot(centre - meshCentre, normal);
+        order[c] = static_cast<unsigned int>(c);
+    }
+
+    // Draw the clusters facing out the most first
+    std::stable_sort(order.begin(), order.end(), [&sortKey](unsigned int a, unsigned int b)
+    {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        unsigned int cluster = order[c];
+        result.insert(result.end(), indices.begin() + 3 * clusterStarts[cluster],
+                      indices.begin() + 3 * clusterStarts[cluster + 1]);
+    }
+    indices.swap(result);
+}
+
+std::vector<unsigned int> MeshOptimiser::optimiseVertexFetch(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> newIndex(vertexCount, unused);
+    std::vector<unsigned int> order;
+    order.reserve(vertexCount);
+
+    // Number the vertices in the order the index buffer first uses them
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int &index = newIndex[indices[i]];
+        if (index == unused)
+        {
+            index = static_cast<unsigned int>(order.size());
+            order.push_back(indices[i]);
+        }
+        indices[i] = index;
+    }
+
+    return order;
+}
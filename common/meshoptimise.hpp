@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Post-transform vertex cache statistics of an index buffer
+struct CacheStats
+{
+    float acmr;  // average cache miss ratio, vertex shader runs per triangle (0.5 - 3)
+    float atvr;  // average transformed vertex ratio, vertex shader runs per vertex (1 is ideal)
+};
+
+// Reorders indexed triangle meshes for the GPU
+class MeshOptimiser
+{
+public:
+    // Simulate a FIFO post-transform cache of the given size
+    static CacheStats analyseCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                   unsigned int cacheSize = 16);
+
+    // Reorder triangles so that consecutive triangles reuse cached vertices
+    // (Tom Forsyth's linear-speed vertex cache optimisation)
+    static void optimiseVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+
+    // Split the cache optimised triangles into clusters where the cache
+    // restarts and draw the outward facing clusters first so that early-z
+    // rejects more of the hidden fragments
+    static void optimiseOverdraw(std::vector<unsigned int> &indices, const std::vector<glm::vec3> &vertices,
+                                 unsigned int cacheSize = 16);
+
+    // Renumber vertices in the order they are first used so vertex fetches are
+    // sequential, returns the old index of each new vertex
+    static std::vector<unsigned int> optimiseVertexFetch(std::vector<unsigned int> &indices, size_t vertexCount);
+
+    // Reorder an attribute array with the table returned by optimiseVertexFetch
+    template <typename T>
+    static void remap(std::vector<T> &attribute, const std::vector<unsigned int> &order)
+    {
+        std::vector<T> result(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+            result[i] = attribute[order[i]];
+        attribute.swap(result);
+    }
+};
@@ -3,10 +3,13 @@
 #include <vector>
 #include <stdio.h>
 #include <string>
+#include <memory>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "mesh.hpp"
+
 // Texture struct
 struct Texture
 {
@@ -18,49 +21,65 @@ class Model
 {
 public:
     // Model attributes
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec3> tangents;
-    std::vector<glm::vec3> bitangents;
+    std::shared_ptr<Mesh>  mesh;
     std::vector<Texture>   textures;
     unsigned int textureID;
     float ka, kd, ks, Ns;
     
-    // Constructor
-    Model(const char *path);
-    
-    // Draw model
-    void draw(unsigned int &shaderID);
-    
-    // Add textures
-    void addTexture(const char *path, const std::string type);
+    // Loading modes
+    enum LoadMode
+    {
+        Blocking,  // load and upload the mesh in the constructor
+        Async      // load on the thread pool, uploaded by MeshLoader::processUploads
+    };
     
-    // Cleanup
-    void deleteBuffers();
-    
-private:
+    // Constructor. Meshes loaded with options.derivedTangents have no
+    // tangents, their normal mapping frames are built per pixel from screen
+    // space derivatives instead.
+    Model(const char *path, LoadMode mode = Blocking, const MeshOptions &options = MeshOptions());
+
+    // Model for a mesh built in code, with the textures and lighting
+    // coefficients of another model (deleteBuffers releases its textures, the
+    // caller deletes the mesh)
+    Model(const std::shared_ptr<Mesh> &mesh, const Model &material);
     
-    // Array buffers
-    unsigned int VAO;
-    unsigned int vertexBuffer;
-    unsigned int uvBuffer;
-    unsigned int normalBuffer;
-    unsigned int tangentBuffer;
-    unsigned int bitangentBuffer;
+    // True once the mesh can be drawn
+    bool isReady() const;
+
+    // True if the mesh couldn't be loaded, the model is then never drawn and
+    // has no bounds
+    bool hasFailed() const { return !mesh || mesh->hasFailed(); }
 
-    // Calculate tangents and bitangents
-    void calculateTangents();
+    // Bounding volumes of the mesh, and of an instance placed with the given
+    // translation, rotation and scale (only valid once the model is ready)
+    const MeshBounds &bounds() const { return mesh->bounds(); }
+    MeshBounds worldBounds(const glm::mat4 &transform) const { return mesh->bounds().transform(transform); }
     
-    // Load .obj file method
-    bool loadObj(const char *path,
-                 std::vector<glm::vec3> &inVertices,
-                 std::vector<glm::vec2> &inUVs,
-                 std::vector<glm::vec3> &inNormals);
+    // Pick the level of detail for an instance of the model drawn at the given
+    // scale and distance from a camera with the given vertical field of view
+    unsigned int selectLod(float distance, float scale, float fov, float screenHeight, unsigned int current) const;
+
+    // Draw model
+    void draw(unsigned int &shaderID, unsigned int lod = 0);
+
+    // Draw only the positions, for depth only passes that need no material
+    void drawPositions(unsigned int lod = 0);
+
+    // Draw the full detail model culling meshlets against the camera, MVP
+    // and eye are relative to the model. Returns the number of meshlets drawn.
+    unsigned int draw(unsigned int &shaderID, const glm::mat4 &MVP, const glm::vec3 &eye);
+
+    // Draw count instances whose matrices are in the vertex pulling instance
+    // buffer from firstInstance on, with one draw call
+    void drawInstanced(unsigned int &shaderID, unsigned int firstInstance, unsigned int count, unsigned int lod = 0);
     
-    // Setup buffers
-    void setupBuffers();
+    // Add textures, an image already loaded for another model shares its GL texture
+    void addTexture(const char *path, const std::string type);
+
+    // Send the material and textures to the shader, for geometry drawn
+    // outside the model with its material
+    void bindMaterial(unsigned int &shaderID);
     
-    // Load texture
-    unsigned int loadTexture(const char *path);
+    // Cleanup (releases the model's use of its shared mesh and textures)
+    void deleteBuffers();
 };
@@ -0,0 +1,789 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include <common/objloader.hpp>
+#include <common/mappedfile.hpp>
+#include <common/threadpool.hpp>
+
+// Files at least this big are parsed in parallel
+static const size_t parallelThreshold = 4 * 1024 * 1024;
+
+// Streamed files are read this many bytes at a time, and each temporary file
+// is written through a buffer this size
+static const size_t streamBlockSize = 1024 * 1024;
+static const size_t spillBufferSize = 256 * 1024;
+
+// Records of a temporary file no further apart than this are read together,
+// up to this many at a time
+static const unsigned int gatherGap = 256;
+static const unsigned int maxGatherRun = 65536;
+
+// Bytes of an unordered_map entry beyond its key and value (node links and bucket)
+static const size_t weldEntryOverhead = 24;
+
+// Powers of ten that are exactly representable as doubles
+static const double powersOfTen[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Vertex/uv/normal indices of a face corner
+struct ObjCorner
+{
+    unsigned int vertexIndex;
+    unsigned int uvIndex;
+    unsigned int normalIndex;
+
+    bool operator==(const ObjCorner &other) const
+    {
+        return vertexIndex == other.vertexIndex && uvIndex == other.uvIndex
+            && normalIndex == other.normalIndex;
+    }
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner &corner) const
+    {
+        size_t hash = corner.vertexIndex * 73856093u;
+        hash ^= corner.uvIndex * 19349663u;
+        hash ^= corner.normalIndex * 83492791u;
+        return hash;
+    }
+};
+
+// Number of records of each type in a block of .obj text
+struct ObjCounts
+{
+    size_t vertices = 0;
+    size_t uvs = 0;
+    size_t normals = 0;
+    size_t faces = 0;
+};
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline const char *skipBlanks(const char *p, const char *end)
+{
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+static inline const char *nextLine(const char *p, const char *end)
+{
+    const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+// Read a decimal number such as -1.25e-3, returns NULL if there isn't one
+static const char *parseFloat(const char *p, const char *end, float &value)
+{
+    p = skipBlanks(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    // Accumulate the digits into an integer mantissa
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    const char *digitsStart = p;
+    while (p < end && isDigit(*p))
+    {
+        if (mantissa < 100000000000000000ULL)
+            mantissa = mantissa * 10 + (*p - '0');
+        else
+            exponent++;
+        p++;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && isDigit(*p))
+        {
+            if (mantissa < 100000000000000000ULL)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p == digitsStart || (p == digitsStart + 1 && *digitsStart == '.'))
+        return NULL;
+
+    // Optional exponent
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+        {
+            negativeExponent = *q == '-';
+            q++;
+        }
+        if (q < end && isDigit(*q))
+        {
+            int e = 0;
+            while (q < end && isDigit(*q))
+            {
+                if (e < 10000)
+                    e = e * 10 + (*q - '0');
+                q++;
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    // Scale the mantissa by the power of ten
+    double result = static_cast<double>(mantissa);
+    while (exponent > 22)
+    {
+        result *= 1e22;
+        exponent -= 22;
+    }
+    while (exponent < -22)
+    {
+        result /= 1e22;
+        exponent += 22;
+    }
+    if (exponent >= 0)
+        result *= powersOfTen[exponent];
+    else
+        result /= powersOfTen[-exponent];
+
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+// Read an integer, returns NULL if there isn't one
+static inline const char *parseInt(const char *p, const char *end, long long &value)
+{
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    if (p == end || !isDigit(*p))
+        return NULL;
+
+    long long result = 0;
+    while (p < end && isDigit(*p))
+    {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+// Read an .obj index and convert negative (relative) indices to absolute 1-based ones
+static inline const char *parseIndex(const char *p, const char *end, size_t count, unsigned int &index)
+{
+    long long value;
+    p = parseInt(p, end, value);
+    if (p == NULL || value == 0)
+        return NULL;
+
+    if (value < 0)
+        value += static_cast<long long>(count) + 1;
+    index = static_cast<unsigned int>(value);
+    return p;
+}
+
+// Count the records in a block of .obj text so the arrays can be reserved once
+static void countRecords(const char *p, const char *end, ObjCounts &counts)
+{
+    while (p < end)
+    {
+        p = skipBlanks(p, end);
+        if (end - p >= 2)
+        {
+            if (p[0] == 'v' && isBlank(p[1]))
+                counts.vertices++;
+            else if (p[0] == 'v' && p[1] == 't')
+                counts.uvs++;
+            else if (p[0] == 'v' && p[1] == 'n')
+                counts.normals++;
+            else if (p[0] == 'f' && isBlank(p[1]))
+                counts.faces++;
+        }
+        p = nextLine(p, end);
+    }
+}
+
+// Parse the records in a block of .obj text into presized arrays. The cursor
+// holds the number of records of each type that come before the block in the
+// file, which is where the block's records are written and what relative
+// face indices are resolved against.
+static bool parseRecords(const char *p, const char *end, ObjData &data, ObjCounts cursor)
+{
+    while (p < end)
+    {
+        p = skipBlanks(p, end);
+        if (end - p < 2)
+            break;
+
+        bool ok = true;
+        if (p[0] == 'v' && isBlank(p[1]))
+        {
+            // Read vertices
+            glm::vec3 &vertex = data.vertices[cursor.vertices++];
+            ok = (p = parseFloat(p + 1, end, vertex.x)) && (p = parseFloat(p, end, vertex.y))
+                && (p = parseFloat(p, end, vertex.z));
+        }
+        else if (p[0] == 'v' && p[1] == 't')
+        {
+            // Read texture co-ordinates
+            glm::vec2 &uv = data.uvs[cursor.uvs++];
+            ok = (p = parseFloat(p + 2, end, uv.x)) && (p = parseFloat(p, end, uv.y));
+        }
+        else if (p[0] == 'v' && p[1] == 'n')
+        {
+            // Read vertex normals
+            glm::vec3 &normal = data.normals[cursor.normals++];
+            ok = (p = parseFloat(p + 2, end, normal.x)) && (p = parseFloat(p, end, normal.y))
+                && (p = parseFloat(p, end, normal.z));
+        }
+        else if (p[0] == 'f' && isBlank(p[1]))
+        {
+            // Read vertex/uv/normal indices of the three corners
+            size_t corner = 3 * cursor.faces++;
+            p++;
+            for (int i = 0; i < 3 && ok; i++, corner++)
+            {
+                p = skipBlanks(p, end);
+                ok = (p = parseIndex(p, end, cursor.vertices, data.vertexIndices[corner]))
+                    && p < end && *p++ == '/'
+                    && (p = parseIndex(p, end, cursor.uvs, data.uvIndices[corner]))
+                    && p < end && *p++ == '/'
+                    && (p = parseIndex(p, end, cursor.normals, data.normalIndices[corner]));
+            }
+        }
+
+        if (!ok)
+        {
+            printf("File can't be read by loadObj().\n");
+            return false;
+        }
+
+        // Skip the rest of the line (comments, unsupported records, \r)
+        p = nextLine(p, end);
+    }
+
+    return true;
+}
+
+bool ObjLoader::load(const char *path, ObjData &data, unsigned int threadCount)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        printf("Impossible to open the file. Check paths and directories.\n");
+        return false;
+    }
+
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+
+    // Small files aren't worth splitting up
+    ThreadPool &pool = ThreadPool::shared();
+    if (threadCount == 0)
+        threadCount = file.size() >= parallelThreshold ? pool.size() : 1;
+
+    // Split the file into line aligned chunks
+    std::vector<const char *> chunks(1, begin);
+    for (unsigned int i = 1; i < threadCount; i++)
+    {
+        const char *split = nextLine(begin + file.size() * i / threadCount, end);
+        if (split < end && split > chunks.back())
+            chunks.push_back(split);
+    }
+    chunks.push_back(end);
+    size_t chunkCount = chunks.size() - 1;
+
+    // Count the records in every chunk
+    std::vector<ObjCounts> counts(chunkCount);
+    if (chunkCount == 1)
+    {
+        countRecords(begin, end, counts[0]);
+    }
+    else
+    {
+        std::vector<std::future<void> > jobs;
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            const char *chunkBegin = chunks[i];
+            const char *chunkEnd = chunks[i + 1];
+            ObjCounts *chunkCounts = &counts[i];
+            jobs.push_back(pool.enqueue([=]() { countRecords(chunkBegin, chunkEnd, *chunkCounts); }));
+        }
+        for (size_t i = 0; i < jobs.size(); i++)
+            pool.wait(jobs[i]);
+    }
+
+    // Work out where each chunk's records go in the arrays
+    std::vector<ObjCounts> cursors(chunkCount);
+    ObjCounts total;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        cursors[i] = total;
+        total.vertices += counts[i].vertices;
+        total.uvs += counts[i].uvs;
+        total.normals += counts[i].normals;
+        total.faces += counts[i].faces;
+    }
+
+    // Size every array once
+    data.vertices.resize(total.vertices);
+    data.uvs.resize(total.uvs);
+    data.normals.resize(total.normals);
+    data.vertexIndices.resize(3 * total.faces);
+    data.uvIndices.resize(3 * total.faces);
+    data.normalIndices.resize(3 * total.faces);
+
+    // Parse the chunks straight into their place in the arrays
+    if (chunkCount == 1)
+        return parseRecords(begin, end, data, cursors[0]);
+
+    std::vector<std::future<bool> > jobs;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        const char *chunkBegin = chunks[i];
+        const char *chunkEnd = chunks[i + 1];
+        ObjCounts cursor = cursors[i];
+        ObjData *output = &data;
+        jobs.push_back(pool.enqueue([=]() { return parseRecords(chunkBegin, chunkEnd, *output, cursor); }));
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < jobs.size(); i++)
+        ok = pool.wait(jobs[i]) && ok;
+
+    return ok;
+}
+
+bool ObjLoader::loadStdio(const char *path, ObjData &data)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        printf("Impossible to open the file. Check paths and directories.\n");
+        return false;
+    }
+
+    while (true)
+    {
+        // Read the first word of the line
+        char lineHeader[128];
+        int res = fscanf(file, "%127s", lineHeader);
+        if (res == EOF)
+        {
+            // If end of file reached exit the loop
+            break;
+        }
+
+        if (strcmp(lineHeader, "v") == 0)
+        {
+            // Read vertices
+            glm::vec3 vertex;
+            fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
+            data.vertices.push_back(vertex);
+        }
+        else if (strcmp(lineHeader, "vt") == 0)
+        {
+            // Read texture co-ordinates
+            glm::vec2 uv;
+            fscanf(file, "%f %f\n", &uv.x, &uv.y);
+            data.uvs.push_back(uv);
+        }
+        else if (strcmp(lineHeader, "vn") == 0)
+        {
+            // Read vertex normals
+            glm::vec3 normal;
+            fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+            data.normals.push_back(normal);
+        }
+        else if (strcmp(lineHeader, "f") == 0)
+        {
+            // Read vertex indices
+            unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
+            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n",
+                                 &vertexIndex[0], &uvIndex[0], &normalIndex[0],
+                                 &vertexIndex[1], &uvIndex[1], &normalIndex[1],
+                                 &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
+
+            // Check for error
+            if (matches != 9)
+            {
+                printf("File can't be read by loadObj().\n");
+                fclose(file);
+                return false;
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                data.vertexIndices.push_back(vertexIndex[i]);
+                data.uvIndices.push_back(uvIndex[i]);
+                data.normalIndices.push_back(normalIndex[i]);
+            }
+        }
+        else
+        {
+            // Remove comment line
+            char commentBuffer[1000];
+            fgets(commentBuffer, 1000, file);
+        }
+    }
+
+    // Close .obj file
+    fclose(file);
+
+    return true;
+}
+
+bool ObjLoader::weld(const ObjData &data,
+                     std::vector<glm::vec3> &outVertices,
+                     std::vector<glm::vec2> &outUVs,
+                     std::vector<glm::vec3> &outNormals,
+                     std::vector<unsigned int> &outIndices)
+{
+    size_t count = data.vertexIndices.size();
+    outIndices.reserve(outIndices.size() + count);
+
+    // Map each vertex/uv/normal index triple to its welded vertex
+    std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> welded;
+    welded.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Get the indices of its attributes
+        ObjCorner corner;
+        corner.vertexIndex = data.vertexIndices[i];
+        corner.uvIndex = data.uvIndices[i];
+        corner.normalIndex = data.normalIndices[i];
+
+        if (corner.vertexIndex - 1 >= data.vertices.size() || corner.uvIndex - 1 >= data.uvs.size()
+            || corner.normalIndex - 1 >= data.normals.size())
+        {
+            printf("Face index out of range in loadObj().\n");
+            return false;
+        }
+
+        // Reuse the vertex if this combination has been seen before
+        std::pair<std::unordered_map<ObjCorner, unsigned int, ObjCornerHash>::iterator, bool> result =
+            welded.insert(std::make_pair(corner, static_cast<unsigned int>(outVertices.size())));
+        if (result.second)
+        {
+            // Copy the attributes to the buffers
+            outVertices.push_back(data.vertices[corner.vertexIndex - 1]);
+            outUVs.push_back(data.uvs[corner.uvIndex - 1]);
+            outNormals.push_back(data.normals[corner.normalIndex - 1]);
+        }
+        outIndices.push_back(result.first->second);
+    }
+
+    return true;
+}
+
+// Heap used per face while a window of a stream is welded: its corners, their
+// entries in the weld map, the attribute reads and up to three new vertices
+// with their indices
+static const size_t bytesPerStreamedFace = 3 * (2 * sizeof(ObjCorner) + sizeof(unsigned int) + weldEntryOverhead
+    + 3 * sizeof(std::pair<unsigned int, unsigned int>) + 2 * sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(unsigned int));
+
+// Temporary binary file, deleted when closed
+static FILE *createSpillFile()
+{
+    FILE *file = tmpfile();
+    if (file != NULL)
+        setvbuf(file, NULL, _IOFBF, spillBufferSize);
+    return file;
+}
+
+// Move to a byte offset in a file that may be bigger than 2GB
+static bool seekFile(FILE *file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Temporary files a stream's records are written to as they are parsed
+struct SpillFiles
+{
+    FILE *vertices;
+    FILE *uvs;
+    FILE *normals;
+    FILE *corners;
+};
+
+// Parse the records in a block of .obj text and append them to the temporary
+// files. counts holds the records written so far, which relative face
+// indices are resolved against.
+static bool spillRecords(const char *p, const char *end, const SpillFiles &files, ObjCounts &counts)
+{
+    while (p < end)
+    {
+        p = skipBlanks(p, end);
+        if (end - p < 2)
+            break;
+
+        bool ok = true;
+        if (p[0] == 'v' && isBlank(p[1]))
+        {
+            // Write vertices
+            glm::vec3 vertex;
+            ok = (p = parseFloat(p + 1, end, vertex.x)) && (p = parseFloat(p, end, vertex.y))
+                && (p = parseFloat(p, end, vertex.z)) && fwrite(&vertex, sizeof(vertex), 1, files.vertices) == 1;
+            counts.vertices++;
+        }
+        else if (p[0] == 'v' && p[1] == 't')
+        {
+            // Write texture co-ordinates
+            glm::vec2 uv;
+            ok = (p = parseFloat(p + 2, end, uv.x)) && (p = parseFloat(p, end, uv.y))
+                && fwrite(&uv, sizeof(uv), 1, files.uvs) == 1;
+            counts.uvs++;
+        }
+        else if (p[0] == 'v' && p[1] == 'n')
+        {
+            // Write vertex normals
+            glm::vec3 normal;
+            ok = (p = parseFloat(p + 2, end, normal.x)) && (p = parseFloat(p, end, normal.y))
+                && (p = parseFloat(p, end, normal.z)) && fwrite(&normal, sizeof(normal), 1, files.normals) == 1;
+            counts.normals++;
+        }
+        else if (p[0] == 'f' && isBlank(p[1]))
+        {
+            // Write the vertex/uv/normal indices of the three corners
+            ObjCorner corners[3];
+            p++;
+            for (int i = 0; i < 3 && ok; i++)
+            {
+                p = skipBlanks(p, end);
+                ok = (p = parseIndex(p, end, counts.vertices, corners[i].vertexIndex))
+                    && p < end && *p++ == '/'
+                    && (p = parseIndex(p, end, counts.uvs, corners[i].uvIndex))
+                    && p < end && *p++ == '/'
+                    && (p = parseIndex(p, end, counts.normals, corners[i].normalIndex));
+            }
+            ok = ok && fwrite(corners, sizeof(ObjCorner), 3, files.corners) == 3;
+            counts.faces++;
+        }
+
+        if (!ok)
+        {
+            printf("File can't be read by loadObj().\n");
+            return false;
+        }
+
+        // Skip the rest of the line (comments, unsupported records, \r)
+        p = nextLine(p, end);
+    }
+
+    return true;
+}
+
+// Read the records of a temporary file that a window needs into their slots.
+// Each request is a record number and a slot, records close together in the
+// file are read with one call.
+template <typename T>
+static bool gatherRecords(FILE *file, std::vector<std::pair<unsigned int, unsigned int> > &requests, std::vector<T> &output)
+{
+    std::sort(requests.begin(), requests.end());
+    std::vector<T> run;
+    size_t i = 0;
+    while (i < requests.size())
+    {
+        size_t j = i + 1;
+        while (j < requests.size() && requests[j].first - requests[j - 1].first <= gatherGap
+               && requests[j].first - requests[i].first < maxGatherRun)
+            j++;
+
+        unsigned int first = requests[i].first;
+        run.resize(requests[j - 1].first - first + 1);
+        if (!seekFile(file, static_cast<uint64_t>(first) * sizeof(T))
+            || fread(&run[0], sizeof(T), run.size(), file) != run.size())
+            return false;
+        for (size_t k = i; k < j; k++)
+            output[requests[k].second] = run[requests[k].first - first];
+        i = j;
+    }
+    return true;
+}
+
+ObjStream::ObjStream() : vertexFile(NULL), uvFile(NULL), normalFile(NULL), cornerFile(NULL),
+    vertexCount(0), uvCount(0), normalCount(0), faces(0), facesRead(0), windowFaces(0)
+{
+}
+
+ObjStream::~ObjStream()
+{
+    close();
+}
+
+bool ObjStream::open(const char *path, size_t memoryBudget)
+{
+    close();
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Impossible to open the file. Check paths and directories.\n");
+        return false;
+    }
+
+    vertexFile = createSpillFile();
+    uvFile = createSpillFile();
+    normalFile = createSpillFile();
+    cornerFile = createSpillFile();
+    if (!vertexFile || !uvFile || !normalFile || !cornerFile)
+    {
+        printf("Unable to create temporary files for %s\n", path);
+        fclose(file);
+        close();
+        return false;
+    }
+
+    // Parse whole lines a block at a time, carrying a partial line over to the next block
+    SpillFiles files = { vertexFile, uvFile, normalFile, cornerFile };
+    ObjCounts counts;
+    std::vector<char> block(streamBlockSize);
+    size_t kept = 0;
+    bool ok = true;
+    while (ok)
+    {
+        size_t read = fread(&block[kept], 1, block.size() - kept, file);
+        size_t filled = kept + read;
+        if (read == 0)
+        {
+            ok = spillRecords(&block[0], &block[0] + filled, files, counts);
+            break;
+        }
+
+        const char *begin = &block[0];
+        const char *stop = begin + filled;
+        while (stop > begin && stop[-1] != '\n')
+            stop--;
+        if (stop == begin)
+        {
+            // A line longer than the block
+            if (filled == block.size())
+                block.resize(2 * block.size());
+            kept = filled;
+            continue;
+        }
+
+        ok = spillRecords(begin, stop, files, counts);
+        kept = begin + filled - stop;
+        memmove(&block[0], stop, kept);
+    }
+    fclose(file);
+    if (!ok)
+    {
+        close();
+        return false;
+    }
+
+    vertexCount = counts.vertices;
+    uvCount = counts.uvs;
+    normalCount = counts.normals;
+    faces = counts.faces;
+    facesRead = 0;
+    windowFaces = std::max(memoryBudget / bytesPerStreamedFace, size_t(1));
+    fflush(vertexFile);
+    fflush(uvFile);
+    fflush(normalFile);
+    return seekFile(cornerFile, 0);
+}
+
+bool ObjStream::next(ObjChunk &chunk)
+{
+    chunk.vertices.clear();
+    chunk.uvs.clear();
+    chunk.normals.clear();
+    chunk.indices.clear();
+    if (cornerFile == NULL || facesRead == faces)
+        return false;
+
+    // The window's corners, in file order
+    size_t count = 3 * std::min(windowFaces, faces - facesRead);
+    std::vector<ObjCorner> corners(count);
+    if (fread(&corners[0], sizeof(ObjCorner), count, cornerFile) != count)
+    {
+        printf("Unable to read back the faces of a streamed .obj file\n");
+        return false;
+    }
+    facesRead += count / 3;
+
+    // Weld the corners within the window, noting which attributes the new vertices need
+    std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> welded;
+    welded.reserve(count);
+    std::vector<std::pair<unsigned int, unsigned int> > vertexReads, uvReads, normalReads;
+    chunk.indices.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const ObjCorner &corner = corners[i];
+        if (corner.vertexIndex - 1 >= vertexCount || corner.uvIndex - 1 >= uvCount
+            || corner.normalIndex - 1 >= normalCount)
+        {
+            printf("Face index out of range in loadObj().\n");
+            return false;
+        }
+
+        unsigned int vertex = static_cast<unsigned int>(vertexReads.size());
+        std::pair<std::unordered_map<ObjCorner, unsigned int, ObjCornerHash>::iterator, bool> result =
+            welded.insert(std::make_pair(corner, vertex));
+        if (result.second)
+        {
+            vertexReads.push_back(std::make_pair(corner.vertexIndex - 1, vertex));
+            uvReads.push_back(std::make_pair(corner.uvIndex - 1, vertex));
+            normalReads.push_back(std::make_pair(corner.normalIndex - 1, vertex));
+        }
+        chunk.indices.push_back(result.first->second);
+    }
+
+    // Fetch the attributes from the temporary files
+    size_t vertexTotal = vertexReads.size();
+    chunk.vertices.resize(vertexTotal);
+    chunk.uvs.resize(vertexTotal);
+    chunk.normals.resize(vertexTotal);
+    if (!gatherRecords(vertexFile, vertexReads, chunk.vertices) || !gatherRecords(uvFile, uvReads, chunk.uvs)
+        || !gatherRecords(normalFile, normalReads, chunk.normals))
+    {
+        printf("Unable to read back the vertices of a streamed .obj file\n");
+        return false;
+    }
+    return true;
+}
+
+void ObjStream::close()
+{
+    FILE **files[4] = { &vertexFile, &uvFile, &normalFile, &cornerFile };
+    for (int i = 0; i < 4; i++)
+    {
+        if (*files[i] != NULL)
+            fclose(*files[i]);
+        *files[i] = NULL;
+    }
+    vertexCount = uvCount = normalCount = faces = facesRead = windowFaces = 0;
+}
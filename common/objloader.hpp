@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <stdio.h>
+
+#include <glm/glm.hpp>
+
+// Contents of an .obj file as it appears in the file (indices are 1-based)
+struct ObjData
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> vertexIndices;
+    std::vector<unsigned int> uvIndices;
+    std::vector<unsigned int> normalIndices;
+};
+
+// Wavefront .obj file loader
+class ObjLoader
+{
+public:
+    // Parse an .obj file straight from a memory mapping of the file. Large files
+    // are split into line aligned chunks that are parsed on the shared thread
+    // pool, threadCount overrides the number of chunks (0 picks automatically).
+    static bool load(const char *path, ObjData &data, unsigned int threadCount = 0);
+
+    // Parse an .obj file with fscanf (reference implementation used by the benchmark)
+    static bool loadStdio(const char *path, ObjData &data);
+
+    // Weld face corners with the same vertex/uv/normal indices into a list of
+    // unique vertices and an index buffer of three indices per triangle
+    static bool weld(const ObjData &data,
+                     std::vector<glm::vec3> &outVertices,
+                     std::vector<glm::vec2> &outUVs,
+                     std::vector<glm::vec3> &outNormals,
+                     std::vector<unsigned int> &outIndices);
+};
+
+// Welded triangles from one window of an .obj file's faces
+struct ObjChunk
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+};
+
+// Reads .obj files too big to hold in memory. open() makes one pass over the
+// file, reading it a block at a time and writing the vertices, uvs, normals
+// and face corners to temporary binary files. next() then reads the faces
+// back a window at a time and welds each window into a chunk with its own
+// vertices, which can be built into a mesh, uploaded and freed before the
+// next one is read. Vertices used by more than one window are repeated in
+// each. Windows are sized so the memory used stays near the budget (plus a
+// few fixed size buffers) however big the file is, as long as each chunk is
+// freed before asking for the next.
+class ObjStream
+{
+public:
+    // Constructor and destructor
+    ObjStream();
+    ~ObjStream();
+
+    // Parse an .obj file into the temporary files
+    bool open(const char *path, size_t memoryBudget = 64 * 1024 * 1024);
+
+    // Weld the next window of faces into chunk, false once every face has
+    // been read or if the file is bad
+    bool next(ObjChunk &chunk);
+
+    // Number of triangles in the file, and the most in one chunk
+    size_t faceCount() const { return faces; }
+    size_t windowSize() const { return windowFaces; }
+
+    // Delete the temporary files
+    void close();
+
+private:
+    FILE *vertexFile;
+    FILE *uvFile;
+    FILE *normalFile;
+    FILE *cornerFile;
+    size_t vertexCount;
+    size_t uvCount;
+    size_t normalCount;
+    size_t faces;
+    size_t facesRead;
+    size_t windowFaces;
+
+    // Streams can't be copied
+    ObjStream(const ObjStream &);
+    ObjStream &operator=(const ObjStream &);
+};
@@ -0,0 +1,29 @@
+#include <stdlib.h>
+
+#include <common/paths.hpp>
+
+#ifdef _WIN32
+#include <algorithm>
+#else
+#include <limits.h>
+#endif
+
+std::string canonicalPath(const char *path)
+{
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path, _MAX_PATH) == NULL)
+        return path;
+
+    // Paths on Windows are case insensitive and accept either slash
+    std::string result(resolved);
+    std::replace(result.begin(), result.end(), '\\', '/');
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved) == NULL)
+        return path;
+    return resolved;
+#endif
+}
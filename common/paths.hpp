@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Absolute path with . and .. resolved, so different spellings of the same
+// file compare equal. Falls back to the path as given if it can't be resolved.
+std::string canonicalPath(const char *path);
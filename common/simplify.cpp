@@ -0,0 +1,251 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <common/simplify.hpp>
+
+// Sum of squared distances to a set of planes, weighted by triangle area
+struct Quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, weight;
+
+    Quadric() { memset(this, 0, sizeof(*this)); }
+
+    // Quadric of the plane through a triangle
+    Quadric(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+    {
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area > 0.0f)
+            normal /= area;
+        double a = normal.x, b = normal.y, c = normal.z, d = -glm::dot(normal, p0);
+        double w = area;
+        a2 = w * a * a; ab = w * a * b; ac = w * a * c; ad = w * a * d;
+        b2 = w * b * b; bc = w * b * c; bd = w * b * d;
+        c2 = w * c * c; cd = w * c * d;
+        d2 = w * d * d;
+        weight = w;
+    }
+
+    void add(const Quadric &q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+    }
+
+    // Mean squared distance of a point from the planes
+    double error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double sum = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                   + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                   + c2 * z * z + 2 * cd * z
+                   + d2;
+        return weight > 0.0 ? std::abs(sum) / weight : 0.0;
+    }
+};
+
+// A possible collapse of vertex from onto vertex to
+struct Collapse
+{
+    unsigned int from, to;
+    float cost;
+
+    bool operator<(const Collapse &other) const { return cost < other.cost; }
+};
+
+// Hash of a position's bits, used to find vertices split along seams
+struct PositionHash
+{
+    size_t operator()(const glm::vec3 &p) const
+    {
+        unsigned int bits[3];
+        memcpy(bits, &p[0], sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+float MeshSimplifier::simplify(std::vector<unsigned int> &indices, const std::vector<glm::vec3> &vertices,
+                               size_t targetIndexCount, float targetError)
+{
+    size_t vertexCount = vertices.size();
+    if (indices.size() <= targetIndexCount || vertexCount == 0)
+        return 0.0f;
+
+    // Work in a unit sized box so errors are relative to the mesh size
+    glm::vec3 boundsMin = vertices[0], boundsMax = vertices[0];
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+        boundsMin = glm::min(boundsMin, vertices[i]);
+        boundsMax = glm::max(boundsMax, vertices[i]);
+    }
+    glm::vec3 size = boundsMax - boundsMin;
+    float extent = std::max(size.x, std::max(size.y, size.z));
+    float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+    std::vector<glm::vec3> positions(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+        positions[i] = (vertices[i] - boundsMin) * scale;
+
+    // Vertices split on seams share a position, only vertices that are the sole
+    // user of their position can move or be collapsed onto
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> firstAtPosition;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<unsigned int> wedges(vertexCount, 0);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        remap[i] = firstAtPosition.insert(std::make_pair(vertices[i], static_cast<unsigned int>(i))).first->second;
+        wedges[remap[i]]++;
+    }
+
+    std::vector<bool> movable(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+        movable[i] = remap[i] == i && wedges[i] == 1;
+
+    // Vertices on open edges stay where they are
+    std::unordered_set<unsigned long long> edges;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        for (int k = 0; k < 3; k++)
+            edges.insert((static_cast<unsigned long long>(remap[indices[i + k]]) << 32) | remap[indices[i + (k + 1) % 3]]);
+
+    std::vector<bool> border(vertexCount, false);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = remap[indices[i + k]], b = remap[indices[i + (k + 1) % 3]];
+            if (edges.find((static_cast<unsigned long long>(b) << 32) | a) == edges.end())
+                border[a] = border[b] = true;
+        }
+    }
+
+    // Quadric of every position from the planes of the triangles around it
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        Quadric q(positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]);
+        for (int k = 0; k < 3; k++)
+            quadrics[remap[indices[i + k]]].add(q);
+    }
+
+    double errorLimit = double(targetError) * targetError;
+    double resultError = 0.0;
+    std::vector<unsigned int> offsets, adjacency, filled;
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> collapseTo(vertexCount);
+    std::vector<bool> touched(vertexCount);
+
+    while (indices.size() > targetIndexCount)
+    {
+        size_t triangleCount = indices.size() / 3;
+
+        // List the triangles around each vertex
+        offsets.assign(vertexCount + 1, 0);
+        for (size_t i = 0; i < indices.size(); i++)
+            offsets[indices[i] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(indices.size());
+        filled.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+        // Cost of every allowed edge collapse
+        collapses.clear();
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    unsigned int from = direction == 0 ? a : b, to = direction == 0 ? b : a;
+                    if (!movable[from] || border[from] || !movable[to])
+                        continue;
+
+                    Quadric q = quadrics[from];
+                    q.add(quadrics[to]);
+                    Collapse collapse = { from, to, static_cast<float>(q.error(positions[to])) };
+                    if (collapse.cost <= errorLimit)
+                        collapses.push_back(collapse);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        // Apply the cheapest collapses, each vertex is only involved in one
+        // change per pass so the flip checks stay valid
+        for (size_t v = 0; v < vertexCount; v++)
+            collapseTo[v] = static_cast<unsigned int>(v);
+        touched.assign(vertexCount, false);
+        size_t trianglesToRemove = (indices.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        for (size_t c = 0; c < collapses.size() && removed < trianglesToRemove; c++)
+        {
+            const Collapse &collapse = collapses[c];
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Reject collapses that would flip a triangle over
+            bool flips = false;
+            unsigned int shared = 0;
+            for (unsigned int j = offsets[collapse.from]; j < offsets[collapse.from + 1] && !flips; j++)
+            {
+                const unsigned int *triangle = &indices[3 * adjacency[j]];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    shared++;
+                    continue;
+                }
+
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = positions[triangle[k]];
+                    q[k] = triangle[k] == collapse.from ? positions[collapse.to] : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            // Lock the neighbourhood for the rest of the pass
+            for (unsigned int j = offsets[collapse.from]; j < offsets[collapse.from + 1]; j++)
+                for (int k = 0; k < 3; k++)
+                    touched[indices[3 * adjacency[j] + k]] = true;
+
+            collapseTo[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            resultError = std::max(resultError, double(collapse.cost));
+            removed += shared;
+        }
+
+        if (removed == 0)
+            break;
+
+        // Rewrite the triangles and drop the ones that collapsed to nothing
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            unsigned int a = collapseTo[indices[3 * t]];
+            unsigned int b = collapseTo[indices[3 * t + 1]];
+            unsigned int c = collapseTo[indices[3 * t + 2]];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+                continue;
+
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    return static_cast<float>(std::sqrt(resultError));
+}
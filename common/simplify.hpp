@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Reduces the triangle count of indexed meshes
+class MeshSimplifier
+{
+public:
+    // Collapse edges in order of least quadric error until at most
+    // targetIndexCount indices are left or the next collapse would move the
+    // surface further than targetError (relative to the size of the mesh).
+    // Vertices are shared with the source mesh, only the index buffer changes,
+    // and vertices on borders or uv and normal seams are left in place.
+    // Returns the error of the simplified mesh.
+    static float simplify(std::vector<unsigned int> &indices, const std::vector<glm::vec3> &vertices,
+                          size_t targetIndexCount, float targetError);
+};
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/staticbatch.hpp>
+#include <common/threadpool.hpp>
+
+void StaticBatch::add(const Model &model, const glm::mat4 &transform)
+{
+    Instance instance = { model.mesh, &model, transform };
+    instances.push_back(instance);
+}
+
+void StaticBatch::build(const MeshOptions &options)
+{
+    buildOptions = options;
+    building = true;
+}
+
+void StaticBatch::update()
+{
+    if (!building)
+        return;
+
+    // Wait for every mesh to be uploaded (or fail), so its cache has been written
+    if (!merging.valid())
+    {
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            if (!instances[i].mesh->isReady() && !instances[i].mesh->hasFailed())
+                return;
+        }
+
+        std::vector<Instance> sources = instances;
+        MeshOptions options = buildOptions;
+        merging = ThreadPool::shared().enqueue([sources, options]() { return merge(sources, options); });
+        return;
+    }
+
+    if (merging.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    // Only the upload is left for the GL thread
+    std::vector<Merged> merged = merging.get();
+    for (size_t i = 0; i < merged.size(); i++)
+    {
+        merged[i].mesh->upload();
+        batches.push_back(Model(merged[i].mesh, *merged[i].material));
+    }
+
+    building = false;
+    instances.clear();
+}
+
+std::vector<StaticBatch::Merged> StaticBatch::merge(const std::vector<Instance> &instances, const MeshOptions &options)
+{
+    // Read each mesh back once
+    std::map<const Mesh *, BatchGeometry> sources;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const Mesh *source = instances[i].mesh.get();
+        if (sources.count(source) || source->hasFailed())
+            continue;
+
+        BatchGeometry &geometry = sources[source];
+        if (!source->readGeometry(geometry.vertices, geometry.uvs, geometry.normals, geometry.indices))
+            printf("Unable to read a mesh back for static batching\n");
+    }
+
+    // One mesh per material, in the order the materials were first used
+    std::vector<Merged> batches;
+    std::vector<bool> done(instances.size(), false);
+    for (size_t first = 0; first < instances.size(); first++)
+    {
+        if (done[first])
+            continue;
+
+        const Model *material = instances[first].material;
+        std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+        unsigned int objectCount = 0;
+        for (size_t i = first; i < instances.size(); i++)
+        {
+            if (instances[i].material != material)
+                continue;
+            done[i] = true;
+
+            const BatchGeometry &geometry = sources[instances[i].mesh.get()];
+            if (geometry.indices.empty())
+                continue;
+            objectCount++;
+
+            append(*mesh, geometry, instances[i].transform);
+        }
+
+        // Tangents are generated for the merged mesh, so they are already in world space
+        std::string name = "static batch " + std::to_string(batches.size());
+        printf("Merging %u objects into %s, %u triangles\n", objectCount, name.c_str(),
+               static_cast<unsigned int>(mesh->indices.size() / 3));
+        if (!mesh->build(name.c_str(), options))
+            continue;
+
+        Merged batch = { mesh, material };
+        batches.push_back(batch);
+    }
+
+    return batches;
+}
+
+void StaticBatch::append(Mesh &mesh, const BatchGeometry &geometry, const glm::mat4 &transform)
+{
+    // Move the vertices into the world, normals by the inverse transpose
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+    unsigned int base = static_cast<unsigned int>(mesh.vertices.size());
+    for (size_t v = 0; v < geometry.vertices.size(); v++)
+    {
+        mesh.vertices.push_back(glm::vec3(transform * glm::vec4(geometry.vertices[v], 1.0f)));
+        mesh.uvs.push_back(geometry.uvs[v]);
+        mesh.normals.push_back(glm::normalize(normalMatrix * geometry.normals[v]));
+    }
+
+    // A mirroring transform turns the triangles inside out, so swap their winding back
+    bool mirrored = glm::determinant(glm::mat3(transform)) < 0.0f;
+    for (size_t t = 0; t < geometry.indices.size(); t += 3)
+    {
+        mesh.indices.push_back(base + geometry.indices[t]);
+        mesh.indices.push_back(base + geometry.indices[t + (mirrored ? 2 : 1)]);
+        mesh.indices.push_back(base + geometry.indices[t + (mirrored ? 1 : 2)]);
+    }
+}
+
+void StaticBatch::draw(unsigned int &shaderID)
+{
+    for (size_t i = 0; i < batches.size(); i++)
+        batches[i].draw(shaderID);
+}
+
+void StaticBatch::drawPositions()
+{
+    for (size_t i = 0; i < batches.size(); i++)
+        batches[i].drawPositions();
+}
+
+void StaticBatch::deleteBuffers()
+{
+    for (size_t i = 0; i < batches.size(); i++)
+    {
+        batches[i].mesh->deleteBuffers();
+        batches[i].deleteBuffers();
+    }
+    batches.clear();
+}
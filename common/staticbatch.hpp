@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <future>
+
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+
+// Full detail geometry of a mesh, read back for merging
+struct BatchGeometry
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+};
+
+// Objects that never move, merged into one mesh per material with their
+// transformations baked into the vertices. Each material is drawn with one
+// call whatever the number of objects using it, with the model matrix left
+// as the identity. The merging runs on the thread pool once the objects'
+// meshes have loaded, so building doesn't hold up the render loop.
+class StaticBatch
+{
+public:
+    // Add an object with the mesh, textures and lighting coefficients of a
+    // model, placed by transform. The model has to outlive the build.
+    void add(const Model &model, const glm::mat4 &transform);
+
+    // Merge the objects added so far into the batches once update() finds
+    // their meshes loaded. Each mesh is read back once however many objects
+    // use it.
+    void build(const MeshOptions &options = MeshOptions());
+
+    // Start the merge once the meshes are ready and upload the batches once
+    // it has finished, call once per frame from the GL context thread
+    void update();
+
+    // Draw every batch, the caller sets the view and projection matrices
+    void draw(unsigned int &shaderID);
+
+    // Draw the positions of every batch, for depth only passes
+    void drawPositions();
+
+    // Number of batches (draw calls)
+    unsigned int size() const { return static_cast<unsigned int>(batches.size()); }
+
+    // Cleanup
+    void deleteBuffers();
+
+    // Append geometry moved by transform to a mesh's attribute vectors
+    static void append(Mesh &mesh, const BatchGeometry &geometry, const glm::mat4 &transform);
+
+private:
+    struct Instance
+    {
+        std::shared_ptr<Mesh> mesh;
+        const Model *material;
+        glm::mat4 transform;
+    };
+
+    // Batch built on the thread pool, waiting to be uploaded
+    struct Merged
+    {
+        std::shared_ptr<Mesh> mesh;
+        const Model *material;
+    };
+
+    std::vector<Instance> instances;
+    std::vector<Model> batches;
+    MeshOptions buildOptions;
+    bool building = false;
+    std::future<std::vector<Merged> > merging;
+
+    // Merge objects into one mesh per material, on a pool thread
+    static std::vector<Merged> merge(const std::vector<Instance> &instances, const MeshOptions &options);
+};
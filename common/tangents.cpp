@@ -0,0 +1,203 @@
+#include <cmath>
+#include <future>
+
+#include <common/tangents.hpp>
+#include <common/threadpool.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TANGENTS_SSE
+#endif
+
+// Meshes with at least this many triangles are processed in parallel
+static const size_t parallelThreshold = 65536;
+
+// Tangent and bitangent of every triangle, one array per component so four
+// triangles can be computed and stored at once
+struct FaceTangents
+{
+    std::vector<float> tangent[3];
+    std::vector<float> bitangent[3];
+};
+
+// Run a job over count items split into ranges on the shared pool
+template <typename F>
+static void parallelRanges(size_t count, unsigned int rangeCount, F job)
+{
+    if (rangeCount <= 1)
+    {
+        job(size_t(0), count);
+        return;
+    }
+
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<std::future<void> > jobs;
+    for (unsigned int i = 0; i < rangeCount; i++)
+    {
+        size_t begin = count * i / rangeCount;
+        size_t end = count * (i + 1) / rangeCount;
+        jobs.push_back(pool.enqueue([=]() { job(begin, end); }));
+    }
+    for (size_t i = 0; i < jobs.size(); i++)
+        pool.wait(jobs[i]);
+}
+
+// Tangent and bitangent of the triangles in [begin, end), triangles with
+// degenerate texture co-ordinates get zero vectors
+static void faceTangents(const glm::vec3 *vertices, const glm::vec2 *uvs, const unsigned int *indices,
+                         size_t begin, size_t end, FaceTangents &faces)
+{
+    size_t t = begin;
+
+#ifdef TANGENTS_SSE
+    // Four triangles at a time
+    for (; t + 4 <= end; t += 4)
+    {
+        float p[3][3][4], u[3][4], v[3][4];
+        for (int k = 0; k < 4; k++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int index = indices[3 * (t + k) + c];
+                p[c][0][k] = vertices[index].x;
+                p[c][1][k] = vertices[index].y;
+                p[c][2][k] = vertices[index].z;
+                u[c][k] = uvs[index].x;
+                v[c][k] = uvs[index].y;
+            }
+        }
+
+        // Texture co-ordinate deltas and the reciprocal of their determinant
+        __m128 deltaU1 = _mm_sub_ps(_mm_loadu_ps(u[1]), _mm_loadu_ps(u[0]));
+        __m128 deltaV1 = _mm_sub_ps(_mm_loadu_ps(v[1]), _mm_loadu_ps(v[0]));
+        __m128 deltaU2 = _mm_sub_ps(_mm_loadu_ps(u[2]), _mm_loadu_ps(u[1]));
+        __m128 deltaV2 = _mm_sub_ps(_mm_loadu_ps(v[2]), _mm_loadu_ps(v[1]));
+        __m128 det = _mm_sub_ps(_mm_mul_ps(deltaU1, deltaV2), _mm_mul_ps(deltaU2, deltaV1));
+        __m128 valid = _mm_cmpneq_ps(det, _mm_setzero_ps());
+        __m128 denom = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), det));
+
+        for (int c = 0; c < 3; c++)
+        {
+            // Edge vectors
+            __m128 E1 = _mm_sub_ps(_mm_loadu_ps(p[1][c]), _mm_loadu_ps(p[0][c]));
+            __m128 E2 = _mm_sub_ps(_mm_loadu_ps(p[2][c]), _mm_loadu_ps(p[1][c]));
+
+            __m128 tangent = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaV2, E1), _mm_mul_ps(deltaV1, E2)), denom);
+            __m128 bitangent = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaU1, E2), _mm_mul_ps(deltaU2, E1)), denom);
+            _mm_storeu_ps(&faces.tangent[c][t], tangent);
+            _mm_storeu_ps(&faces.bitangent[c][t], bitangent);
+        }
+    }
+#endif
+
+    // Remaining triangles
+    for (; t < end; t++)
+    {
+        unsigned int i0 = indices[3 * t], i1 = indices[3 * t + 1], i2 = indices[3 * t + 2];
+
+        glm::vec3 E1 = vertices[i1] - vertices[i0];
+        glm::vec3 E2 = vertices[i2] - vertices[i1];
+        float deltaU1 = uvs[i1].x - uvs[i0].x;
+        float deltaV1 = uvs[i1].y - uvs[i0].y;
+        float deltaU2 = uvs[i2].x - uvs[i1].x;
+        float deltaV2 = uvs[i2].y - uvs[i1].y;
+
+        float det = deltaU1 * deltaV2 - deltaU2 * deltaV1;
+        float denom = det != 0.0f ? 1.0f / det : 0.0f;
+        glm::vec3 tangent = (deltaV2 * E1 - deltaV1 * E2) * denom;
+        glm::vec3 bitangent = (deltaU1 * E2 - deltaU2 * E1) * denom;
+        for (int c = 0; c < 3; c++)
+        {
+            faces.tangent[c][t] = tangent[c];
+            faces.bitangent[c][t] = bitangent[c];
+        }
+    }
+}
+
+// Sum the tangents of the triangles around the vertices in [begin, end) and
+// build an orthonormal frame with the vertex normal
+static void vertexTangents(const std::vector<glm::vec3> &normals, const std::vector<unsigned int> &offsets,
+                           const std::vector<unsigned int> &adjacency, const FaceTangents &faces,
+                           size_t begin, size_t end, std::vector<glm::vec4> &tangents)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        glm::vec3 tangent(0.0f), bitangent(0.0f);
+        for (unsigned int j = offsets[i]; j < offsets[i + 1]; j++)
+        {
+            unsigned int t = adjacency[j];
+            tangent += glm::vec3(faces.tangent[0][t], faces.tangent[1][t], faces.tangent[2][t]);
+            bitangent += glm::vec3(faces.bitangent[0][t], faces.bitangent[1][t], faces.bitangent[2][t]);
+        }
+
+        glm::vec3 n = normals[i];
+        float length = glm::dot(n, n);
+        n = length > 0.0f ? n / std::sqrt(length) : glm::vec3(0.0f, 0.0f, 1.0f);
+
+        // Remove the normal component, vertices without a usable tangent get
+        // any vector perpendicular to the normal
+        glm::vec3 t = tangent - n * glm::dot(n, tangent);
+        if (glm::dot(t, t) < 1e-12f)
+            t = std::abs(n.x) < 0.9f ? glm::cross(n, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(n, glm::vec3(0.0f, 1.0f, 0.0f));
+        t = glm::normalize(t);
+
+        float handedness = glm::dot(glm::cross(n, t), bitangent) < 0.0f ? -1.0f : 1.0f;
+        tangents[i] = glm::vec4(t, handedness);
+    }
+}
+
+void TangentGenerator::generate(const std::vector<glm::vec3> &vertices,
+                                const std::vector<glm::vec2> &uvs,
+                                const std::vector<glm::vec3> &normals,
+                                const std::vector<unsigned int> &indices,
+                                std::vector<glm::vec4> &tangents,
+                                unsigned int threadCount)
+{
+    size_t vertexCount = vertices.size();
+    size_t triangleCount = indices.size() / 3;
+    tangents.resize(vertexCount);
+    if (vertexCount == 0)
+        return;
+
+    // Small meshes aren't worth splitting up
+    if (threadCount == 0)
+        threadCount = triangleCount >= parallelThreshold ? ThreadPool::shared().size() : 1;
+
+    // Tangent of every triangle
+    FaceTangents faces;
+    for (int c = 0; c < 3; c++)
+    {
+        faces.tangent[c].resize(triangleCount);
+        faces.bitangent[c].resize(triangleCount);
+    }
+    const glm::vec3 *vertexData = &vertices[0];
+    const glm::vec2 *uvData = &uvs[0];
+    const unsigned int *indexData = indices.empty() ? NULL : &indices[0];
+    FaceTangents *output = &faces;
+    parallelRanges(triangleCount, threadCount, [=](size_t begin, size_t end)
+    {
+        faceTangents(vertexData, uvData, indexData, begin, end, *output);
+    });
+
+    // List the triangles around each vertex
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    // Tangent frame of every vertex
+    const std::vector<unsigned int> *offsetData = &offsets;
+    const std::vector<unsigned int> *adjacencyData = &adjacency;
+    const std::vector<glm::vec3> *normalData = &normals;
+    std::vector<glm::vec4> *result = &tangents;
+    parallelRanges(vertexCount, threadCount, [=](size_t begin, size_t end)
+    {
+        vertexTangents(*normalData, *offsetData, *adjacencyData, *output, begin, end, *result);
+    });
+}
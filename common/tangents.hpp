@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Generates smooth tangent frames for indexed triangle meshes
+class TangentGenerator
+{
+public:
+    // Tangent of every vertex, accumulated over the triangles that use it and
+    // orthonormalised against the vertex normal. w holds the handedness, the
+    // bitangent is cross(normal, tangent) * w. Large meshes are split into
+    // triangle ranges on the shared thread pool, threadCount overrides the
+    // number of ranges (0 picks automatically).
+    static void generate(const std::vector<glm::vec3> &vertices,
+                         const std::vector<glm::vec2> &uvs,
+                         const std::vector<glm::vec3> &normals,
+                         const std::vector<unsigned int> &indices,
+                         std::vector<glm::vec4> &tangents,
+                         unsigned int threadCount = 0);
+};
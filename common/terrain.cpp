@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <cmath>
+#include <chrono>
+
+#include <common/terrain.hpp>
+#include <common/meshlets.hpp>
+#include <common/geometryarena.hpp>
+#include <common/threadpool.hpp>
+
+// Distance over which the hills rise from the flat square, and the width of the largest hills
+static const float flatBlend = 32.0f;
+static const float hillWavelength = 128.0f;
+static const unsigned int noiseOctaves = 5;
+
+// Fraction of a level's range after which its vertices start morphing into the next level
+static const float morphStart = 0.7f;
+
+// Children are generated once the camera is this much of their range away
+static const float prefetchRange = 1.25f;
+
+// Chunks uploaded per frame, and frames an unused chunk is kept for
+static const unsigned int maxUploadsPerFrame = 8;
+static const unsigned int evictAfterFrames = 600;
+
+// Floats per vertex: position, normal, height and normal of the next level
+static const unsigned int vertexFloats = 10;
+
+// Hash of a lattice point to [0, 1]
+static float lattice(int x, int z)
+{
+    unsigned int h = static_cast<unsigned int>(x) * 374761393u + static_cast<unsigned int>(z) * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return float(h ^ (h >> 16)) / 4294967295.0f;
+}
+
+// Lattice values smoothly interpolated
+static float valueNoise(float x, float z)
+{
+    float fx = std::floor(x), fz = std::floor(z);
+    int ix = static_cast<int>(fx), iz = static_cast<int>(fz);
+    float tx = x - fx, tz = z - fz;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    tz = tz * tz * (3.0f - 2.0f * tz);
+
+    float bottom = glm::mix(lattice(ix, iz), lattice(ix + 1, iz), tx);
+    float top = glm::mix(lattice(ix, iz + 1), lattice(ix + 1, iz + 1), tx);
+    return glm::mix(bottom, top, tz);
+}
+
+// Octaves of noise, each at twice the frequency and half the amplitude, in [0, 1]
+static float fractalNoise(float x, float z)
+{
+    float sum = 0.0f, total = 0.0f, amplitude = 0.5f;
+    for (unsigned int octave = 0; octave < noiseOctaves; octave++)
+    {
+        sum += amplitude * valueNoise(x, z);
+        total += amplitude;
+        x *= 2.0f;
+        z *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    return sum / total;
+}
+
+// True if any of a box is within radius of a point
+static bool intersectsSphere(const BoundingBox &box, const glm::vec3 &centre, float radius)
+{
+    glm::vec3 closest = glm::clamp(centre, box.min, box.max);
+    glm::vec3 offset = closest - centre;
+    return glm::dot(offset, offset) <= radius * radius;
+}
+
+// False if a box is entirely outside one of the frustum planes
+static bool inFrustum(const BoundingBox &box, const glm::vec4 planes[6])
+{
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        // Corner of the box furthest along the plane's normal
+        glm::vec3 corner(planes[i].x >= 0.0f ? box.max.x : box.min.x,
+                         planes[i].y >= 0.0f ? box.max.y : box.min.y,
+                         planes[i].z >= 0.0f ? box.max.z : box.min.z);
+        if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+Terrain::Terrain(const TerrainOptions &terrainOptions) : options(terrainOptions), EBO(0), frame(0), uploadsLeft(0)
+{
+    // Enough samples for a vertex of the finest level at every one
+    samples = options.gridSize << (options.levels - 1);
+    spacing = options.size / samples;
+    unsigned int width = samples + 1;
+    heights.resize(static_cast<size_t>(width) * width);
+
+    // Rows of the heightmap are generated in parallel
+    ThreadPool &pool = ThreadPool::shared();
+    unsigned int rowsPerJob = (width + pool.size() - 1) / pool.size();
+    std::vector<std::future<void> > jobs;
+    for (unsigned int first = 0; first < width; first += rowsPerJob)
+    {
+        unsigned int last = glm::min(first + rowsPerJob, width);
+        jobs.push_back(pool.enqueue([this, first, last, width]()
+        {
+            for (unsigned int z = first; z < last; z++)
+            {
+                for (unsigned int x = 0; x < width; x++)
+                {
+                    float worldX = x * spacing - 0.5f * options.size, worldZ = z * spacing - 0.5f * options.size;
+                    float edge = glm::max(std::abs(worldX), std::abs(worldZ));
+                    float hills = glm::smoothstep(options.flatRadius, options.flatRadius + flatBlend, edge);
+                    heights[static_cast<size_t>(z) * width + x] = options.baseHeight
+                        + hills * options.hillHeight * fractalNoise(worldX / hillWavelength, worldZ / hillWavelength);
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < jobs.size(); i++)
+        pool.wait(jobs[i]);
+
+    // Each level is drawn twice as far as the one below it
+    for (unsigned int level = 0; level < options.levels; level++)
+        ranges.push_back(options.firstRange * float(1u << level));
+
+    // Quadtree down to the finest level
+    size_t nodeCount = 0;
+    for (unsigned int level = 0; level < options.levels; level++)
+        nodeCount += size_t(1) << (2 * level);
+    nodes.reserve(nodeCount);
+    addNode(options.levels - 1, 0, 0);
+
+    // Grid indices, one quarter after another so the quarters can be drawn on their own
+    unsigned int n = options.gridSize, half = n / 2;
+    std::vector<unsigned short> indices;
+    indices.reserve(static_cast<size_t>(n) * n * 6);
+    for (unsigned int quarter = 0; quarter < 4; quarter++)
+    {
+        unsigned int x0 = (quarter & 1) * half, z0 = (quarter >> 1) * half;
+        for (unsigned int j = z0; j < z0 + half; j++)
+        {
+            for (unsigned int i = x0; i < x0 + half; i++)
+            {
+                // Split along the same diagonal at every level, so each
+                // vertex of a level lies on an edge of the next one
+                unsigned short a = static_cast<unsigned short>(j * (n + 1) + i);
+                unsigned short b = static_cast<unsigned short>(a + 1);
+                unsigned short c = static_cast<unsigned short>(a + n + 1);
+                unsigned short d = static_cast<unsigned short>(c + 1);
+                unsigned short quad[6] = { a, c, d, a, d, b };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    }
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // The root covers everything in range, so it is always there
+    request(0);
+    nodes[0].vertices.wait();
+    printf("Terrain of %u x %u samples in %u levels\n", width, width, options.levels);
+}
+
+unsigned int Terrain::addNode(unsigned int level, unsigned int x, unsigned int z)
+{
+    unsigned int index = static_cast<unsigned int>(nodes.size());
+    Node node;
+    node.level = level;
+    node.x = x;
+    node.z = z;
+    node.VAO = 0;
+    node.VBO = 0;
+    node.lastUsed = 0;
+    for (unsigned int c = 0; c < 4; c++)
+        node.children[c] = 0;
+    nodes.push_back(std::move(node));
+
+    // Height range of the samples the chunk covers
+    unsigned int extent = options.gridSize << level;
+    BoundingBox box;
+    box.min = glm::vec3(x * spacing - 0.5f * options.size, 0.0f, z * spacing - 0.5f * options.size);
+    box.max = box.min + glm::vec3(extent * spacing, 0.0f, extent * spacing);
+    box.min.y = box.max.y = sample(x, z);
+    if (level == 0)
+    {
+        for (unsigned int j = z; j <= z + extent; j++)
+        {
+            for (unsigned int i = x; i <= x + extent; i++)
+            {
+                box.min.y = glm::min(box.min.y, sample(i, j));
+                box.max.y = glm::max(box.max.y, sample(i, j));
+            }
+        }
+    }
+    else
+    {
+        // Coarser chunks use a subset of their children's samples
+        unsigned int half = extent / 2;
+        for (unsigned int c = 0; c < 4; c++)
+        {
+            unsigned int child = addNode(level - 1, x + (c & 1) * half, z + (c >> 1) * half);
+            nodes[index].children[c] = child;
+            box.min.y = glm::min(box.min.y, nodes[child].box.min.y);
+            box.max.y = glm::max(box.max.y, nodes[child].box.max.y);
+        }
+    }
+    nodes[index].box = box;
+    return index;
+}
+
+float Terrain::sample(int x, int z) const
+{
+    int last = static_cast<int>(samples);
+    x = glm::clamp(x, 0, last);
+    z = glm::clamp(z, 0, last);
+    return heights[static_cast<size_t>(z) * (samples + 1) + x];
+}
+
+glm::vec3 Terrain::normal(int x, int z, int step) const
+{
+    float dx = sample(x - step, z) - sample(x + step, z);
+    float dz = sample(x, z - step) - sample(x, z + step);
+    return glm::normalize(glm::vec3(dx, 2.0f * step * spacing, dz));
+}
+
+std::vector<float> Terrain::generate(unsigned int index) const
+{
+    const Node &node = nodes[index];
+    int step = 1 << node.level;
+    unsigned int n = options.gridSize;
+    std::vector<float> vertices;
+    vertices.reserve(static_cast<size_t>(n + 1) * (n + 1) * vertexFloats);
+
+    for (unsigned int j = 0; j <= n; j++)
+    {
+        for (unsigned int i = 0; i <= n; i++)
+        {
+            int x = node.x + i * step, z = node.z + j * step;
+            glm::vec3 vertexNormal = normal(x, z, step);
+
+            // The next level has every other vertex, the rest lie halfway
+            // along one of its edges, or across the diagonal of one of its quads
+            int ax = x, az = z, bx = x, bz = z;
+            if (i & 1)
+            {
+                ax -= step;
+                bx += step;
+            }
+            if (j & 1)
+            {
+                az -= step;
+                bz += step;
+            }
+            float parentHeight = 0.5f * (sample(ax, az) + sample(bx, bz));
+            glm::vec3 parentNormal = glm::normalize(normal(ax, az, 2 * step) + normal(bx, bz, 2 * step));
+
+            float vertex[vertexFloats] =
+            {
+                x * spacing - 0.5f * options.size, sample(x, z), z * spacing - 0.5f * options.size,
+                vertexNormal.x, vertexNormal.y, vertexNormal.z,
+                parentHeight, parentNormal.x, parentNormal.y, parentNormal.z
+            };
+            vertices.insert(vertices.end(), vertex, vertex + vertexFloats);
+        }
+    }
+    return vertices;
+}
+
+void Terrain::request(unsigned int index)
+{
+    Node &node = nodes[index];
+    if (node.VAO != 0 || node.vertices.valid())
+        return;
+
+    node.vertices = ThreadPool::shared().enqueue([this, index]() { return generate(index); });
+}
+
+bool Terrain::isReady(unsigned int index)
+{
+    Node &node = nodes[index];
+    if (node.VAO != 0)
+        return true;
+    if (!node.vertices.valid() || uploadsLeft == 0
+        || node.vertices.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+
+    // Upload the vertices with the shared indices
+    std::vector<float> vertices = node.vertices.get();
+    uploadsLeft--;
+    glGenVertexArrays(1, &node.VAO);
+    glBindVertexArray(node.VAO);
+    glGenBuffers(1, &node.VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, node.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+
+    // Positions and normals where the standard layout has them, the next
+    // level's height and normal after the tangents
+    GLsizei stride = vertexFloats * sizeof(float);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GeometryArena::unbind();
+    return true;
+}
+
+bool Terrain::select(unsigned int index, const glm::vec3 &eye, const glm::vec4 planes[6], std::vector<Selection> &selected)
+{
+    Node &node = nodes[index];
+    if (!intersectsSphere(node.box, eye, ranges[node.level]))
+        return false;
+
+    // Not generated yet, the parent is drawn in its place
+    node.lastUsed = frame;
+    if (!isReady(index))
+    {
+        request(index);
+        return false;
+    }
+
+    // In range but off screen, there is nothing to draw
+    if (!inFrustum(node.box, planes))
+        return true;
+
+    // Drawn whole at the finest level or when out of range of the next one
+    if (node.level == 0 || !intersectsSphere(node.box, eye, ranges[node.level - 1]))
+    {
+        // Start on the children before they come into range
+        if (node.level > 0 && intersectsSphere(node.box, eye, prefetchRange * ranges[node.level - 1]))
+        {
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                nodes[node.children[c]].lastUsed = frame;
+                request(node.children[c]);
+            }
+        }
+
+        Selection selection = { index, 15u };
+        selected.push_back(selection);
+        return true;
+    }
+
+    // Otherwise the children are drawn, with this chunk filling the quarters they don't
+    unsigned int quarters = 0;
+    for (unsigned int c = 0; c < 4; c++)
+    {
+        if (!select(node.children[c], eye, planes, selected))
+            quarters |= 1u << c;
+    }
+    if (quarters != 0)
+    {
+        Selection selection = { index, quarters };
+        selected.push_back(selection);
+    }
+    return true;
+}
+
+unsigned int Terrain::draw(unsigned int &shaderID, Model &material, const Camera &camera)
+{
+    frame++;
+    uploadsLeft = maxUploadsPerFrame;
+
+    // Pick the chunks against the frustum in the world
+    glm::mat4 viewProjection = camera.projection * camera.view;
+    glm::vec4 planes[6];
+    Meshlets::frustumPlanes(viewProjection, planes);
+    std::vector<Selection> selected;
+    select(0, camera.eye, planes, selected);
+
+    // The vertices are already in the world
+    glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, &viewProjection[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(shaderID, "MV"), 1, GL_FALSE, &camera.view[0][0]);
+    glUniform3fv(glGetUniformLocation(shaderID, "eye"), 1, &camera.eye[0]);
+    glUniform1f(glGetUniformLocation(shaderID, "uvScale"), options.uvScale);
+    material.bindMaterial(shaderID);
+
+    GLint morphLocation = glGetUniformLocation(shaderID, "morphRange");
+    GLsizei quarterIndices = static_cast<GLsizei>(options.gridSize * options.gridSize / 4 * 6);
+    for (size_t s = 0; s < selected.size(); s++)
+    {
+        const Node &node = nodes[selected[s].node];
+
+        // Morph over the end of the level's range, the coarsest level has nothing to morph into
+        glm::vec2 morphRange(1e30f, 2e30f);
+        if (node.level + 1 < options.levels)
+        {
+            float previous = node.level > 0 ? ranges[node.level - 1] : 0.0f;
+            morphRange = glm::vec2(glm::mix(previous, ranges[node.level], morphStart), ranges[node.level]);
+        }
+        glUniform2fv(morphLocation, 1, &morphRange[0]);
+
+        glBindVertexArray(node.VAO);
+        if (selected[s].quarters == 15u)
+        {
+            glDrawElements(GL_TRIANGLES, 4 * quarterIndices, GL_UNSIGNED_SHORT, (void *)0);
+            continue;
+        }
+        for (unsigned int q = 0; q < 4; q++)
+        {
+            if (selected[s].quarters & (1u << q))
+                glDrawElements(GL_TRIANGLES, quarterIndices, GL_UNSIGNED_SHORT, (void *)(q * quarterIndices * sizeof(unsigned short)));
+        }
+    }
+    glBindVertexArray(0);
+    GeometryArena::unbind();
+
+    // Free the chunks that haven't been needed for a while, apart from the root
+    for (size_t i = 1; i < nodes.size(); i++)
+    {
+        Node &node = nodes[i];
+        if (node.VAO != 0 && frame - node.lastUsed > evictAfterFrames)
+        {
+            glDeleteVertexArrays(1, &node.VAO);
+            glDeleteBuffers(1, &node.VBO);
+            node.VAO = node.VBO = 0;
+        }
+    }
+    return static_cast<unsigned int>(selected.size());
+}
+
+void Terrain::deleteBuffers()
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        // Jobs still generating vertices read the heightmap
+        Node &node = nodes[i];
+        if (node.vertices.valid())
+            node.vertices.wait();
+        if (node.VAO != 0)
+        {
+            glDeleteVertexArrays(1, &node.VAO);
+            glDeleteBuffers(1, &node.VBO);
+            node.VAO = node.VBO = 0;
+        }
+    }
+    nodes.clear();
+    if (EBO != 0)
+        glDeleteBuffers(1, &EBO);
+    EBO = 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <future>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+#include "camera.hpp"
+#include "bounds.hpp"
+
+// Terrain settings
+struct TerrainOptions
+{
+    float size = 512.0f;         // side of the square of terrain, centred on the origin
+    unsigned int levels = 6;     // levels of detail, the finest chunks are size / 2^(levels - 1) wide
+    unsigned int gridSize = 32;  // quads along each side of every chunk
+    float baseHeight = 0.0f;     // height of the flat ground
+    float hillHeight = 30.0f;    // highest the hills rise above it
+    float flatRadius = 0.0f;     // square around the origin kept flat, the hills rise beyond it
+    float firstRange = 40.0f;    // distance the finest level is drawn to, doubling with each level
+    float uvScale = 0.5f;        // texture repeats per world unit
+};
+
+// Heightmap terrain drawn as a quadtree of chunks with continuous distance
+// based level of detail (CDLOD). Every chunk is the same grid of quads, so
+// a chunk one level coarser covers four times the area with the same number
+// of triangles. Chunks in range of the camera are subdivided and the rest
+// are drawn whole, and towards the end of its range each vertex morphs onto
+// the surface of the next level so there are no pops or cracks between
+// levels. Chunk vertices are generated on the thread pool the first time a
+// chunk is needed, with its parent drawn in its place until then.
+class Terrain
+{
+public:
+    // Constructor, generates the heightmap and the root chunk
+    Terrain(const TerrainOptions &options = TerrainOptions());
+
+    // Draw the chunks the camera can see with the terrain shader and the
+    // textures and lighting coefficients of material. The caller sets the
+    // light uniforms. Returns the number of chunks drawn.
+    unsigned int draw(unsigned int &shaderID, Model &material, const Camera &camera);
+
+    // Cleanup
+    void deleteBuffers();
+
+private:
+    struct Node
+    {
+        unsigned int level;
+        unsigned int x, z;           // first heightmap sample covered
+        BoundingBox box;
+        unsigned int children[4];    // 0 for the finest level, x halves then z halves
+        unsigned int VAO;
+        unsigned int VBO;
+        std::future<std::vector<float> > vertices;  // being generated
+        unsigned int lastUsed;       // frame the chunk was last drawn or needed
+    };
+
+    // A chunk to draw, whole or only the quarters whose children aren't drawn
+    struct Selection
+    {
+        unsigned int node;
+        unsigned int quarters;       // bit per quarter
+    };
+
+    TerrainOptions options;
+    unsigned int samples;            // heightmap samples along each side, less one
+    float spacing;                   // distance between samples
+    std::vector<float> heights;
+    std::vector<Node> nodes;
+    std::vector<float> ranges;       // distance each level is drawn to
+    unsigned int EBO;                // grid indices, shared by every chunk
+    unsigned int frame;
+    unsigned int uploadsLeft;        // chunks that can still be uploaded this frame
+
+    // Heightmap sample, clamped to the edges
+    float sample(int x, int z) const;
+
+    // Unit normal at a sample from the heights step samples either side
+    glm::vec3 normal(int x, int z, int step) const;
+
+    // Add a node and its children, returns its index
+    unsigned int addNode(unsigned int level, unsigned int x, unsigned int z);
+
+    // Vertices of a chunk: position, height and normal of the next level
+    // at the same place, and normal
+    std::vector<float> generate(unsigned int node) const;
+
+    // Upload a chunk's vertices once they have been generated, true if the
+    // chunk can be drawn
+    bool isReady(unsigned int node);
+
+    // Queue a chunk's vertices for generation if they aren't there yet
+    void request(unsigned int node);
+
+    // Pick the chunks and quarters to draw, false when the node is out of
+    // its level's range so its parent covers it
+    bool select(unsigned int node, const glm::vec3 &eye, const glm::vec4 planes[6], std::vector<Selection> &selected);
+};
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include "textureregistry.hpp"
+#include "threadpool.hpp"
+#include "paths.hpp"
+#include "stb_image.hpp"
+
+std::map<std::string, TextureRegistry::Entry> TextureRegistry::textures;
+unsigned int TextureRegistry::shared = 0;
+size_t TextureRegistry::saved = 0;
+unsigned int TextureRegistry::generations = 0;
+std::mutex TextureRegistry::mutex;
+std::deque<TextureRegistry::Image> TextureRegistry::uploads;
+unsigned int TextureRegistry::loading = 0;
+
+unsigned int TextureRegistry::acquire(const char *path, const TextureOptions &options)
+{
+    std::string key = canonicalPath(path) + "#" + std::to_string(options.flags());
+    std::map<std::string, Entry>::iterator it = textures.find(key);
+    if (it != textures.end())
+    {
+        // Images still decoding are counted once they have been uploaded
+        it->second.users++;
+        it->second.shares++;
+        shared++;
+        saved += it->second.bytes;
+        return it->second.id;
+    }
+
+    Entry entry;
+    glGenTextures(1, &entry.id);
+    entry.generation = ++generations;
+    entry.users = 1;
+    entry.shares = 0;
+    entry.bytes = 0;
+    textures[key] = entry;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loading++;
+    }
+
+    // Decode on the thread pool and hand the image over to the upload queue
+    Image image;
+    image.id = entry.id;
+    image.generation = entry.generation;
+    image.options = options;
+    image.data = NULL;
+    std::string file(path);
+    ThreadPool::shared().enqueue([image, file]() mutable
+    {
+        stbi_set_flip_vertically_on_load_thread(image.options.flipVertically);
+        image.data = stbi_load(file.c_str(), &image.width, &image.height, &image.components, 0);
+        if (!image.data)
+            printf("Texture %s failed to load.\n", file.c_str());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        loading--;
+        if (image.data)
+            uploads.push_back(image);
+    });
+
+    return entry.id;
+}
+
+void TextureRegistry::retain(unsigned int id)
+{
+    for (std::map<std::string, Entry>::iterator it = textures.begin(); it != textures.end(); ++it)
+    {
+        if (it->second.id == id)
+        {
+            it->second.users++;
+            return;
+        }
+    }
+}
+
+void TextureRegistry::release(unsigned int id)
+{
+    for (std::map<std::string, Entry>::iterator it = textures.begin(); it != textures.end(); ++it)
+    {
+        if (it->second.id != id)
+            continue;
+
+        // Delete the texture once nothing uses it, an image still decoding is
+        // thrown away when it arrives
+        if (--it->second.users == 0)
+        {
+            glDeleteTextures(1, &it->second.id);
+            textures.erase(it);
+        }
+        return;
+    }
+}
+
+unsigned int TextureRegistry::processUploads(double timeBudget)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned int uploaded = 0;
+
+    // Always upload at least one image so loading makes progress
+    while (true)
+    {
+        Image image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (uploads.empty())
+                break;
+            image = uploads.front();
+            uploads.pop_front();
+        }
+
+        // Skip images whose texture was released while they were decoding,
+        // its id may have been given to another texture since
+        for (std::map<std::string, Entry>::iterator it = textures.begin(); it != textures.end(); ++it)
+        {
+            if (it->second.id == image.id && it->second.generation == image.generation)
+            {
+                it->second.bytes = upload(image);
+                saved += it->second.shares * it->second.bytes;
+                break;
+            }
+        }
+        stbi_image_free(image.data);
+        uploaded++;
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= timeBudget)
+            break;
+    }
+
+    return uploaded;
+}
+
+void TextureRegistry::finishLoading()
+{
+    while (pending() > 0)
+    {
+        if (processUploads(0.0) == 0)
+            std::this_thread::yield();
+    }
+}
+
+unsigned int TextureRegistry::pending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return loading + static_cast<unsigned int>(uploads.size());
+}
+
+size_t TextureRegistry::upload(const Image &image)
+{
+    GLenum format = GL_RGBA;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 2)
+        format = GL_RG;
+    else if (image.components == 3)
+        format = GL_RGB;
+
+    glBindTexture(GL_TEXTURE_2D, image.id);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+    GLint wrap = image.options.repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Memory of the image and, with mipmaps, every level below it
+    size_t bytes = static_cast<size_t>(image.width) * image.height * image.components;
+    if (image.options.mipmaps)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        for (int w = image.width, h = image.height; w > 1 || h > 1; )
+        {
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+            bytes += static_cast<size_t>(w) * h * image.components;
+        }
+    }
+    else
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
+
+    return bytes;
+}
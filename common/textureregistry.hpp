@@ -0,0 +1,88 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// How an image file is turned into a GL texture
+struct TextureOptions
+{
+    bool flipVertically = false;  // first row of the image at the bottom, as GL expects
+    bool mipmaps = true;          // generate mipmaps and filter between them
+    bool repeat = true;           // repeat the texture outside 0 to 1, otherwise clamp to the edge
+
+    // Bit flags that keep textures loaded with different options apart
+    unsigned int flags() const { return (flipVertically ? 1u : 0u) | (mipmaps ? 2u : 0u) | (repeat ? 4u : 0u); }
+};
+
+// GL textures shared between models, keyed by canonical path and options so
+// each image is decoded and uploaded once however many models use it. Images
+// are decoded on the thread pool and uploaded on the GL context thread, so
+// the textures of a scene can all be requested before waiting for any.
+class TextureRegistry
+{
+public:
+    // Get the texture for an image file, starting to decode it if no model is
+    // using it yet. The texture is empty until its image has been uploaded.
+    static unsigned int acquire(const char *path, const TextureOptions &options = TextureOptions());
+
+    // Add a use of a texture that is already loaded, for models that share
+    // another model's textures. Textures that didn't come from the registry
+    // are left alone.
+    static void retain(unsigned int id);
+
+    // Give up a use of a texture, it is deleted once the last user releases
+    // it. Textures that didn't come from the registry are left alone.
+    static void release(unsigned int id);
+
+    // Upload decoded images until the time budget (in seconds) is used up,
+    // call from the GL context thread. Returns the number uploaded.
+    static unsigned int processUploads(double timeBudget);
+
+    // Wait for every requested image and upload it
+    static void finishLoading();
+
+    // Number of images still decoding or waiting to be uploaded
+    static unsigned int pending();
+
+    // Number of requests that were given an already requested texture and
+    // the texture memory (including mipmaps) they would otherwise have used
+    static unsigned int sharedCount() { return shared; }
+    static size_t savedBytes() { return saved; }
+
+private:
+    struct Entry
+    {
+        unsigned int id;
+        unsigned int generation;  // tells the request apart from earlier ones given a recycled id
+        unsigned int users;
+        unsigned int shares;  // requests that shared the texture
+        size_t bytes;         // 0 until uploaded
+    };
+
+    // Image decoded on the thread pool, waiting to be uploaded
+    struct Image
+    {
+        unsigned int id;
+        unsigned int generation;
+        TextureOptions options;
+        unsigned char *data;
+        int width, height, components;
+    };
+
+    static std::map<std::string, Entry> textures;
+    static unsigned int shared;
+    static size_t saved;
+    static unsigned int generations;
+
+    static std::mutex mutex;
+    static std::deque<Image> uploads;
+    static unsigned int loading;
+
+    // Copy a decoded image into its texture, returns the memory it takes up
+    static size_t upload(const Image &image);
+};
@@ -0,0 +1,67 @@
+#include <common/threadpool.hpp>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : stopping(false)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.push_back(std::thread(&ThreadPool::run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    // Let the workers finish the queued jobs and exit
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+bool ThreadPool::runPending()
+{
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (jobs.empty())
+            return false;
+
+        job = std::move(jobs.front());
+        jobs.pop();
+    }
+
+    job();
+    return true;
+}
+
+void ThreadPool::run()
+{
+    while (true)
+    {
+        // Wait for a job or for the pool to shut down
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+
+        job();
+    }
+}
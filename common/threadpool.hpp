@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <memory>
+#include <utility>
+
+// Fixed size pool of worker threads that run queued jobs
+class ThreadPool
+{
+public:
+    // Constructor (0 threads uses one per hardware thread) and destructor
+    ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    // Queue a job, the returned future holds its result
+    template <typename F>
+    std::future<decltype(std::declval<F>()())> enqueue(F job);
+
+    // Number of worker threads
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    // Pool shared by the whole program
+    static ThreadPool &shared();
+
+    // Wait for a queued job's result, running other queued jobs on the
+    // calling thread meanwhile. Jobs that split their work into more jobs
+    // wait with this so the workers can't all end up blocked.
+    template <typename T>
+    T wait(std::future<T> &result);
+
+    // Run one queued job on the calling thread, returns false if there was none
+    bool runPending();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()> > jobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+    // Worker thread loop
+    void run();
+};
+
+template <typename F>
+std::future<decltype(std::declval<F>()())> ThreadPool::enqueue(F job)
+{
+    typedef decltype(std::declval<F>()()) Result;
+
+    // Wrap the job so its result (or exception) ends up in the future
+    std::shared_ptr<std::packaged_task<Result()> > task =
+        std::make_shared<std::packaged_task<Result()> >(job);
+    std::future<Result> result = task->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push([task]() { (*task)(); });
+    }
+    condition.notify_one();
+
+    return result;
+}
+
+template <typename T>
+T ThreadPool::wait(std::future<T> &result)
+{
+    // Once the queue is empty the jobs being waited for are all running
+    while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        if (!runPending())
+            break;
+    }
+    return result.get();
+}
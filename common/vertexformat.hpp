@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vector>
+#include <string.h>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "meshcache.hpp"
+
+// A vertex attribute: the shader location, the type stored per vertex and how
+// GL reads it. Each attribute also names the mesh stream it is copied from.
+template <GLuint Location, typename T, GLint Components, GLenum GLType, GLboolean Normalised = GL_FALSE>
+struct VertexAttribute
+{
+    typedef T Type;
+    static const GLuint location = Location;
+    static const GLint components = Components;
+    static const GLenum glType = GLType;
+    static const GLboolean normalised = Normalised;
+};
+
+// Attributes read by the vertex shader
+struct PositionAttribute : VertexAttribute<0, glm::vec3, 3, GL_FLOAT>
+{
+    static const void *source(const MeshStreams &streams) { return streams.vertices; }
+};
+
+struct UVAttribute : VertexAttribute<1, glm::vec2, 2, GL_FLOAT>
+{
+    static const void *source(const MeshStreams &streams) { return streams.uvs; }
+};
+
+struct NormalAttribute : VertexAttribute<2, glm::vec3, 3, GL_FLOAT>
+{
+    static const void *source(const MeshStreams &streams) { return streams.normals; }
+};
+
+struct TangentAttribute : VertexAttribute<3, glm::vec4, 4, GL_FLOAT>
+{
+    static const void *source(const MeshStreams &streams) { return streams.tangents; }
+};
+
+// Packed attributes of the compact layout
+struct HalfUVAttribute : VertexAttribute<1, glm::uint32, 2, GL_HALF_FLOAT>
+{
+    static const void *source(const MeshStreams &streams) { return streams.uvs; }
+};
+
+struct PackedNormalAttribute : VertexAttribute<2, glm::uint32, 4, GL_INT_2_10_10_10_REV, GL_TRUE>
+{
+    static const void *source(const MeshStreams &streams) { return streams.normals; }
+};
+
+struct PackedTangentAttribute : VertexAttribute<3, glm::uint32, 4, GL_INT_2_10_10_10_REV, GL_TRUE>
+{
+    static const void *source(const MeshStreams &streams) { return streams.tangents; }
+};
+
+// Interleaved vertex holding the attributes in order
+template <typename... Attributes>
+struct InterleavedVertex;
+
+template <typename Last>
+struct InterleavedVertex<Last>
+{
+    typename Last::Type value;
+};
+
+template <typename First, typename... Rest>
+struct InterleavedVertex<First, Rest...>
+{
+    typename First::Type value;
+    InterleavedVertex<Rest...> rest;
+};
+
+// Byte offset of an attribute within the interleaved vertex
+template <typename Attribute, typename... Attributes>
+struct AttributeOffset;
+
+template <typename Attribute, typename... Rest>
+struct AttributeOffset<Attribute, Attribute, Rest...>
+{
+    static const size_t value = 0;
+};
+
+template <typename Attribute, typename First, typename... Rest>
+struct AttributeOffset<Attribute, First, Rest...>
+{
+    static const size_t value = sizeof(typename First::Type) + AttributeOffset<Attribute, Rest...>::value;
+};
+
+// Sum of the attribute sizes
+template <typename... Attributes>
+struct AttributeSize;
+
+template <>
+struct AttributeSize<>
+{
+    static const size_t value = 0;
+};
+
+template <typename First, typename... Rest>
+struct AttributeSize<First, Rest...>
+{
+    static const size_t value = sizeof(typename First::Type) + AttributeSize<Rest...>::value;
+};
+
+// Vertex format built from a list of attributes. The interleaved vertex,
+// stride, offsets and attribute pointer setup all follow from the list, so
+// adding or dropping an attribute only changes the list.
+template <typename... Attributes>
+class VertexFormat
+{
+public:
+    typedef InterleavedVertex<Attributes...> Vertex;
+
+    // Bytes per interleaved vertex
+    static const size_t stride = sizeof(Vertex);
+
+    // Byte offset of an attribute in the interleaved vertex
+    template <typename Attribute>
+    static size_t offset() { return AttributeOffset<Attribute, Attributes...>::value; }
+
+    // Access an attribute of an interleaved vertex
+    template <typename Attribute>
+    static typename Attribute::Type &get(Vertex &vertex)
+    {
+        return *reinterpret_cast<typename Attribute::Type *>(reinterpret_cast<char *>(&vertex) + offset<Attribute>());
+    }
+
+    // Copy the separate mesh streams into an interleaved vertex array
+    static void interleave(const MeshStreams &streams, std::vector<unsigned char> &data)
+    {
+        data.resize(streams.vertexCount * stride);
+        if (!data.empty())
+        {
+            int expand[] = { (copyAttribute<Attributes>(streams, &data[0]), 0)... };
+            (void)expand;
+        }
+    }
+
+    // Point the attributes of the bound VAO at the bound interleaved array buffer
+    static void setup()
+    {
+        int expand[] = { (setupAttribute<Attributes>(), 0)... };
+        (void)expand;
+    }
+
+private:
+    // Attribute types are all multiples of 4 bytes, so the vertex has no padding
+    static_assert(sizeof(Vertex) == AttributeSize<Attributes...>::value, "Interleaved vertex must not be padded");
+
+    template <typename Attribute>
+    static void copyAttribute(const MeshStreams &streams, unsigned char *data)
+    {
+        const unsigned char *source = static_cast<const unsigned char *>(Attribute::source(streams));
+        unsigned char *destination = data + offset<Attribute>();
+        for (size_t i = 0; i < streams.vertexCount; i++)
+            memcpy(destination + i * stride, source + i * sizeof(typename Attribute::Type), sizeof(typename Attribute::Type));
+    }
+
+    template <typename Attribute>
+    static void setupAttribute()
+    {
+        glEnableVertexAttribArray(Attribute::location);
+        glVertexAttribPointer(Attribute::location, Attribute::components, Attribute::glType, Attribute::normalised,
+                              static_cast<GLsizei>(stride), (void*)offset<Attribute>());
+    }
+};
+
+// Vertex formats of the full float and compact mesh layouts
+typedef VertexFormat<PositionAttribute, UVAttribute, NormalAttribute, TangentAttribute> StandardVertexFormat;
+typedef VertexFormat<PositionAttribute, HalfUVAttribute, PackedNormalAttribute, PackedTangentAttribute> CompactVertexFormat;
+
+// Both layouts without the tangent, for meshes whose materials derive their
+// tangent frames per pixel. The other attributes keep their offsets.
+typedef VertexFormat<PositionAttribute, UVAttribute, NormalAttribute> StandardNoTangentVertexFormat;
+typedef VertexFormat<PositionAttribute, HalfUVAttribute, PackedNormalAttribute> CompactNoTangentVertexFormat;
+
+// Positions on their own for passes that only write depth. Both layouts
+// start with the position, so it is the first bytes of every vertex.
+typedef VertexFormat<PositionAttribute> PositionVertexFormat;
@@ -0,0 +1,70 @@
+#include <stdio.h>
+
+#include <common/vertexpulling.hpp>
+#include <common/geometryarena.hpp>
+
+bool VertexPulling::enabled = false;
+std::vector<glm::mat4> VertexPulling::instances;
+unsigned int VertexPulling::instanceBuffer = 0;
+unsigned int VertexPulling::instanceTexture = 0;
+size_t VertexPulling::instanceCapacity = 0;
+
+void VertexPulling::setEnabled(bool enable)
+{
+    enabled = enable;
+
+    // Make the next draw rebind its arena so the vertex texture gets bound too
+    GeometryArena::unbind();
+    printf("Vertex pulling %s\n", enabled ? "on" : "off");
+}
+
+void VertexPulling::setupShader(unsigned int shaderID)
+{
+    glUseProgram(shaderID);
+    glUniform1i(glGetUniformLocation(shaderID, "vertexData"), vertexUnit);
+    glUniform1i(glGetUniformLocation(shaderID, "instanceData"), instanceUnit);
+}
+
+void VertexPulling::clearInstances()
+{
+    instances.clear();
+}
+
+unsigned int VertexPulling::addInstance(const glm::mat4 &MVP, const glm::mat4 &MV)
+{
+    instances.push_back(MVP);
+    instances.push_back(MV);
+    return static_cast<unsigned int>(instances.size() / 2 - 1);
+}
+
+void VertexPulling::uploadInstances()
+{
+    if (instances.empty())
+        return;
+
+    if (instanceTexture == 0)
+    {
+        glGenBuffers(1, &instanceBuffer);
+        glGenTextures(1, &instanceTexture);
+    }
+
+    // Reallocate the buffer only when it grows, otherwise just overwrite it
+    size_t size = instances.size() * sizeof(glm::mat4);
+    glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+    if (size > instanceCapacity)
+    {
+        glBufferData(GL_TEXTURE_BUFFER, size, &instances[0], GL_STREAM_DRAW);
+        instanceCapacity = size;
+    }
+    else
+    {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, &instances[0]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // Each matrix is four RGBA texels, one per column
+    glActiveTexture(GL_TEXTURE0 + instanceUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+    glActiveTexture(GL_TEXTURE0);
+}
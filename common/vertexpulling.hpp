@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Rendering mode where the vertex shader reads vertices and per-instance
+// matrices from buffer textures instead of vertex attributes. Vertices are
+// fetched by gl_VertexID from the geometry arena's vertex buffer and
+// instances by firstInstance + gl_InstanceID, so meshes of either layout
+// share one shader and consecutive objects with the same mesh are drawn
+// with one instanced call.
+class VertexPulling
+{
+public:
+    // Texture units of the vertex and instance buffer textures, above the ones used by materials
+    static const unsigned int vertexUnit = 15;
+    static const unsigned int instanceUnit = 14;
+
+    // Switch between pulling and the vertex attribute path
+    static bool isEnabled() { return enabled; }
+    static void setEnabled(bool enable);
+
+    // Point a pulling shader's buffer samplers at their texture units
+    static void setupShader(unsigned int shaderID);
+
+    // Start a new list of instances, normally once per frame
+    static void clearInstances();
+
+    // Add an instance's matrices, returns its index for firstInstance
+    static unsigned int addInstance(const glm::mat4 &MVP, const glm::mat4 &MV);
+
+    // Copy the instances to the GPU and bind their buffer texture, call after
+    // adding the instances and before drawing them
+    static void uploadInstances();
+
+private:
+    static bool enabled;
+    static std::vector<glm::mat4> instances;  // MVP then MV for each instance
+    static unsigned int instanceBuffer;
+    static unsigned int instanceTexture;
+    static size_t instanceCapacity;
+};
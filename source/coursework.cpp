@@ -9,10 +9,17 @@
 #include <common/maths.hpp>
 #include <common/camera.hpp>
 #include <common/model.hpp>
+#include <common/textureregistry.hpp>
+#include <common/vertexpulling.hpp>
+#include <common/staticbatch.hpp>
+#include <common/impostor.hpp>
+#include <common/hlod.hpp>
+#include <common/terrain.hpp>
 
 // Function prototypes
 void keyboardInput(GLFWwindow* window);
 void mouseInput(GLFWwindow* window);
+void sendLightSources(unsigned int shaderID);
 
 // Frame timers
 float previousTime = 0.0f;  // time of previous iteration of the loop
@@ -27,6 +34,17 @@ const float jumpDuration = 1.0f;
 
 bool rotateTeapots = false;
 
+// Vertex pulling toggle (P key), held tracks the key so one press toggles once
+bool pullingKeyHeld = false;
+
+// Depth pre-pass toggle (Z key)
+bool depthPrepass = false;
+bool depthPrepassKeyHeld = false;
+
+// Per pixel tangent frames for the teapot and crate materials (T key)
+bool derivedTangents = false;
+bool derivedTangentsKeyHeld = false;
+
 // Create camera object
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f));
 
@@ -38,6 +56,20 @@ struct Object
     glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
     float angle = 0.0f;
     std::string name;
+    unsigned int lod = 0;  // level of detail drawn last frame
+    bool isStatic = false;  // never moves, drawn as part of a static batch
+    bool impostor = false;  // far enough away to be drawn as an impostor this frame
+    bool proxied = false;   // drawn as part of its group's proxy mesh this frame
+    glm::mat4 MV, MVP;      // this frame's matrices, the same for every pass that draws the object
+
+    // Model matrix from the translation, rotation and scale
+    glm::mat4 transform() const
+    {
+        glm::mat4 translateMatrix = Maths::translate(position);// Create translation matrix to move the object to its world position
+        glm::mat4 scaleMatrix = Maths::scale(scale);// Create scaling matrix to resize the object
+        glm::mat4 rotateMatrix = Maths::rotate(angle, rotation);// Create rotation matrix based on angle and axis
+        return translateMatrix * rotateMatrix * scaleMatrix;// Combine transformations into a single model matrix
+    }
 };
 
 // Light struct
@@ -120,17 +152,55 @@ int main(void)
     shaderID = LoadShaders("vertexShader.glsl", "multipleLightsFragmentShader.glsl");
     lightShaderID = LoadShaders("lightVertexShader.glsl", "lightFragmentShader.glsl");
 
+    // The same lighting with vertices and matrices read from buffer textures
+    unsigned int pullingShaderID = LoadShaders("pullingVertexShader.glsl", "multipleLightsFragmentShader.glsl");
+    VertexPulling::setupShader(pullingShaderID);
+
+    // Shaders for baking impostors and for drawing them
+    unsigned int impostorBakeShaderID = LoadShaders("impostorBakeVertexShader.glsl", "impostorBakeFragmentShader.glsl");
+    unsigned int impostorShaderID = LoadShaders("impostorVertexShader.glsl", "impostorFragmentShader.glsl");
+
+    // Shader that copies textures into the atlas tiles of proxy meshes
+    unsigned int hlodBakeShaderID = LoadShaders("hlodBakeVertexShader.glsl", "hlodBakeFragmentShader.glsl");
+
+    // Depth only shader reading the position only stream, for the depth pre-pass
+    unsigned int depthShaderID = LoadShaders("depthVertexShader.glsl", "depthFragmentShader.glsl");
+
+    // Terrain vertices morph between levels of detail, lit like everything else
+    unsigned int terrainShaderID = LoadShaders("terrainVertexShader.glsl", "multipleLightsFragmentShader.glsl");
+
     // Activate shader
     glUseProgram(shaderID);
 
-    // Load models
-    Model teapot("../assets/teapot.obj");
-    Model sphere("../assets/sphere.obj");
-    Model crate("../assets/cube.obj");
-    Model floor("../assets/plane.obj");
-    Model wall("../assets/plane.obj");
-
-    // Load the textures
+    // Load models in the background, each one is drawn once it has been uploaded.
+    // Vertices use the compact layout and the curved meshes are also reordered
+    // for the vertex cache and overdraw. The teapots get simplified levels of
+    // detail for when they are far away, and meshlets that are culled when
+    // they are close.
+    MeshOptions options;
+    options.compact = true;
+    MeshOptions optimised = options;
+    optimised.optimise = true;
+    MeshOptions detailed = optimised;
+    detailed.lods = 3;
+    detailed.meshlets = true;
+    Model teapot("../assets/teapot.obj", Model::Async, detailed);
+    Model sphere("../assets/sphere.obj", Model::Async, optimised);
+    Model crate("../assets/cube.obj", Model::Async, options);
+    Model floor("../assets/plane.obj", Model::Async, options);
+    Model wall("../assets/plane.obj", Model::Async, options);
+
+    // The teapot and crate again without tangents, drawn in their place while
+    // derived tangent frames are switched on (T key) so the two can be compared
+    MeshOptions detailedDerived = detailed;
+    detailedDerived.derivedTangents = true;
+    MeshOptions derived = options;
+    derived.derivedTangents = true;
+    std::shared_ptr<Mesh> teapotDerivedMesh = MeshRegistry::acquire("../assets/teapot.obj", true, detailedDerived);
+    std::shared_ptr<Mesh> crateDerivedMesh = MeshRegistry::acquire("../assets/cube.obj", true, derived);
+
+    // Load the textures, every image is decoded in parallel on the thread pool
+    double textureStart = glfwGetTime();
     teapot.addTexture("../assets/blue.bmp", "diffuse");
     teapot.addTexture("../assets/diamond_normal.png", "normal");
     teapot.addTexture("../assets/neutral_specular.png", "specular");
@@ -149,6 +219,12 @@ int main(void)
     wall.addTexture("../assets/bricks_normal.png", "normal");
     wall.addTexture("../assets/bricks_specular.png", "specular");
 
+    // Upload them before anything is baked from them
+    TextureRegistry::finishLoading();
+    printf("Loaded textures in %.1f ms\n", 1000.0 * (glfwGetTime() - textureStart));
+    printf("Shared %u textures, saving %.1f KB of texture memory\n", TextureRegistry::sharedCount(),
+           TextureRegistry::savedBytes() / 1024.0);
+
     // Use wireframe rendering (comment out to turn off)
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -228,17 +304,17 @@ int main(void)
         obj.name = "wall";
         obj.rotation = wallRotations[i];
         obj.angle = wallAngles[i];
+        obj.isStatic = true;
         objects.push_back(obj);
     }
 
 
-    // Add floor model to objects vector
-    obj.name = "floor";
-    obj.position = glm::vec3(0.0f, -2.0f, 0.0f);
-    obj.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-    obj.rotation = glm::vec3(0.0f, 1.0f, 0.0f);
-    obj.angle = 0.0f;
-    objects.push_back(obj);
+    // The ground is terrain drawn with the floor's material, flat inside
+    // the walls where the floor used to be and rising into hills beyond
+    TerrainOptions terrainOptions;
+    terrainOptions.baseHeight = -2.0f;
+    terrainOptions.flatRadius = 12.0f;
+    Terrain terrain(terrainOptions);
 
 
 
@@ -268,6 +344,39 @@ int main(void)
     wall.ks = 1.0f;
     wall.Ns = 3.0f;
 
+    // The models without tangents share the textures and lighting of the others
+    Model teapotDerived(teapotDerivedMesh, teapot);
+    Model crateDerived(crateDerivedMesh, crate);
+
+    // The walls never move, so they are merged into one mesh with their
+    // transformations applied to the vertices, once the wall model has loaded
+    StaticBatch staticBatch;
+    for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+    {
+        if (objects[i].isStatic)
+            staticBatch.add(wall, objects[i].transform());
+    }
+    staticBatch.build(options);
+
+    // Teapots and crates close to each other are merged into simplified
+    // proxy meshes, drawn in place of the group once it is small on screen.
+    // They are built in the background once the models have loaded.
+    const float maxProxyPixels = 150.0f;
+    Hlod hlod;
+    for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+    {
+        if (objects[i].name == "teapot")
+            hlod.add(i, teapot, objects[i].transform());
+        else if (objects[i].name == "crate")
+            hlod.add(i, crate, objects[i].transform());
+    }
+    hlod.build(hlodBakeShaderID, 6.0f, optimised);
+
+    // Teapots and crates further away than this are drawn as impostors,
+    // which are baked once their models have loaded
+    const float impostorDistance = 12.0f;
+    Impostor teapotImpostor, crateImpostor;
+
 
 
     //Attenuation
@@ -308,6 +417,14 @@ int main(void)
     light.type = 3;
     lightSources.push_back(light);
 
+    // Scene draw times, averaged and printed every couple of seconds so the
+    // vertex attribute and pulling paths can be compared
+    unsigned int timerQuery;
+    glGenQueries(1, &timerQuery);
+    bool timerQueryPending = false;
+    double cpuDrawTime = 0.0, gpuDrawTime = 0.0, reportTime = 0.0;
+    unsigned int timedFrames = 0;
+
     // Render loop
     while (!glfwWindowShouldClose(window))
     {
@@ -320,76 +437,258 @@ int main(void)
         keyboardInput(window);
         mouseInput(window);
 
+        // Upload models that have finished loading (2ms budget per frame)
+        MeshLoader::processUploads(0.002);
+        if (!teapotImpostor.isBaked() && !teapot.hasFailed() && teapot.isReady())
+            teapotImpostor.bake(teapot, impostorBakeShaderID);
+        if (!crateImpostor.isBaked() && !crate.hasFailed() && crate.isReady())
+            crateImpostor.bake(crate, impostorBakeShaderID);
+        staticBatch.update();
+        hlod.update();
+
         // Clear the window
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Activate shader
-        glUseProgram(shaderID);
+        unsigned int sceneShaderID = VertexPulling::isEnabled() ? pullingShaderID : shaderID;
+        glUseProgram(sceneShaderID);
 
         // Send multiple light source properties to the shader
-        for (unsigned int i = 0; i < static_cast<unsigned int>(lightSources.size()); i++)
-        {
-            glm::vec3 viewSpaceLightPosition = glm::vec3(camera.view * glm::vec4(lightSources[i].position, 1.0f));
-            std::string idx = std::to_string(i);
-            glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].colour").c_str()), 1, &lightSources[i].colour[0]);
-            glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].position").c_str()), 1, &viewSpaceLightPosition[0]);
-            glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].constant").c_str()), lightSources[i].constant);
-            glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].linear").c_str()), lightSources[i].linear);
-            glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].quadratic").c_str()), lightSources[i].quadratic);
-            glUniform1i(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].type").c_str()), lightSources[i].type);
-
-            //Spotlight
-            glm::vec3 viewSpaceLightDirection = glm::vec3(camera.view * glm::vec4(lightSources[i].direction, 0.0f));
-            glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].direction").c_str()), 1, &viewSpaceLightDirection[0]);
-            glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].cosPhi").c_str()), lightSources[i].cosPhi);
-        }
+        sendLightSources(sceneShaderID);
+
 
+        // Tangent frames from vertex tangents or screen space derivatives, for comparing the two
+        Model &teapotDrawn = derivedTangents && teapotDerived.isReady() ? teapotDerived : teapot;
+        Model &crateDrawn = derivedTangents && crateDerived.isReady() ? crateDerived : crate;
 
         // Send object lighting properties to the fragment shader
-        glUniform1f(glGetUniformLocation(shaderID, "ka"), teapot.ka);
-        glUniform1f(glGetUniformLocation(shaderID, "kd"), teapot.kd);
-        glUniform1f(glGetUniformLocation(shaderID, "ks"), teapot.ks);
-        glUniform1f(glGetUniformLocation(shaderID, "Ns"), teapot.Ns);
+        glUniform1f(glGetUniformLocation(sceneShaderID, "ka"), teapot.ka);
+        glUniform1f(glGetUniformLocation(sceneShaderID, "kd"), teapot.kd);
+        glUniform1f(glGetUniformLocation(sceneShaderID, "ks"), teapot.ks);
+        glUniform1f(glGetUniformLocation(sceneShaderID, "Ns"), teapot.Ns);
 
         // Calculate view and projection matrices
         camera.target = camera.eye + camera.front;
         camera.calculateMatrices();
 
-        glUniformMatrix4fv(glGetUniformLocation(shaderID, "V"), 1, GL_FALSE, &camera.view[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(sceneShaderID, "V"), 1, GL_FALSE, &camera.view[0][0]);
+
+        // Collect the last frame's GPU time, then start timing this one
+        if (timerQueryPending)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &nanoseconds);
+            gpuDrawTime += nanoseconds * 1e-9;
+            timedFrames++;
+        }
+        double drawStart = glfwGetTime();
+        glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+
+        // Groups that are small on screen swap to their proxy, unless one of
+        // their objects has moved since the proxy was built
+        std::vector<unsigned int> proxies;
+        for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+            objects[i].proxied = false;
+        for (unsigned int c = 0; c < hlod.clusterCount(); c++)
+        {
+            const std::vector<unsigned int> &members = hlod.members(c);
+            bool moved = false;
+            for (unsigned int m = 0; m < static_cast<unsigned int>(members.size()); m++)
+                moved = moved || hlod.hasMoved(members[m], objects[members[m]].transform());
+            if (moved || !hlod.useProxy(c, camera.eye, camera.fov, 768.0f, maxProxyPixels))
+                continue;
+
+            proxies.push_back(c);
+            for (unsigned int m = 0; m < static_cast<unsigned int>(members.size()); m++)
+                objects[members[m]].proxied = true;
+        }
+
+        // Other distant teapots and crates swap to their impostors once those are baked
+        bool anyImpostors = false;
+        for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+        {
+            Impostor *impostor = objects[i].name == "teapot" ? &teapotImpostor : objects[i].name == "crate" ? &crateImpostor : NULL;
+            objects[i].impostor = impostor && impostor->isBaked() && !objects[i].proxied
+                && glm::length(camera.eye - objects[i].position) > impostorDistance;
+            anyImpostors = anyImpostors || objects[i].impostor;
+        }
+
+        // Pick each teapot's level of detail from its size on screen, before
+        // the depth pre-pass so both passes draw the same triangles
+        for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+        {
+            if (objects[i].name != "teapot")
+                continue;
+            float distance = glm::length(camera.eye - objects[i].position);
+            float scale = glm::max(objects[i].scale.x, glm::max(objects[i].scale.y, objects[i].scale.z));
+            objects[i].lod = teapot.selectLod(distance, scale, camera.fov, 768.0f, objects[i].lod);
+        }
+
+        // Work out each object's matrices once. Matrix products round
+        // differently in a different order, so the depth pre-pass, the lit
+        // pass and the pulling instances all take these to write the same depths.
+        for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+        {
+            objects[i].MV = camera.view * objects[i].transform();
+            objects[i].MVP = camera.projection * objects[i].MV;
+        }
+
+        // With vertex pulling every object's matrices go in one buffer
+        // texture, indexed by the object's position in the objects vector.
+        // Static objects are already in the world so they only need the camera's.
+        glm::mat4 viewProjection = camera.projection * camera.view;
+        unsigned int staticInstance = 0;
+        if (VertexPulling::isEnabled())
+        {
+            VertexPulling::clearInstances();
+            for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+            {
+                if (objects[i].isStatic)
+                {
+                    VertexPulling::addInstance(viewProjection, camera.view);
+                    continue;
+                }
+                VertexPulling::addInstance(objects[i].MVP, objects[i].MV);
+            }
+            staticInstance = VertexPulling::addInstance(viewProjection, camera.view);
+            VertexPulling::uploadInstances();
+        }
+
+        // Depth pre-pass: the depth of the objects is laid down first from
+        // the position only stream, so the lighting shader then only runs for
+        // the fragments that end up visible
+        if (depthPrepass)
+        {
+            glUseProgram(depthShaderID);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+            {
+                if (objects[i].isStatic || objects[i].proxied || objects[i].impostor)
+                    continue;
+
+                glUniformMatrix4fv(glGetUniformLocation(depthShaderID, "MVP"), 1, GL_FALSE, &objects[i].MVP[0][0]);
+                if (objects[i].name == "teapot")
+                    teapotDrawn.drawPositions(objects[i].lod);
+                else if (objects[i].name == "crate")
+                    crateDrawn.drawPositions();
+            }
+
+            glUniformMatrix4fv(glGetUniformLocation(depthShaderID, "MVP"), 1, GL_FALSE, &viewProjection[0][0]);
+            staticBatch.drawPositions();
+            for (unsigned int p = 0; p < static_cast<unsigned int>(proxies.size()); p++)
+                hlod.drawPositions(proxies[p]);
+
+            // The lit pass only draws where it matches the depth already there
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_LEQUAL);
+            glUseProgram(sceneShaderID);
+        }
 
         //TeapotLoop
         for (int i = 0; i < static_cast<unsigned int>(objects.size()); i++)//for each object in objects
         {
-            // Calculate model matrix
-            glm::mat4 translate = Maths::translate(objects[i].position);// Create translation matrix to move the object to its world position
-            glm::mat4 scale = Maths::scale(objects[i].scale);// Create scaling matrix to resize the object
-            glm::mat4 rotate = Maths::rotate(objects[i].angle, objects[i].rotation);// Create rotation matrix based on angle and axis
-            glm::mat4 model = translate * rotate * scale;// Combine transformations into a single model matrix
+            // Static objects are drawn with their batch and distant ones as proxies or impostors below
+            if (objects[i].isStatic || objects[i].proxied || objects[i].impostor)
+                continue;
 
-            // Calculate Model-View and Model-View-Projection matrices
+            // Calculate model matrix
+            glm::mat4 model = objects[i].transform();
 
-            glm::mat4 MV = camera.view * model;// Combine model matrix with view matrix (camera)
-            glm::mat4 MVP = camera.projection * MV;// Combine MV with projection matrix to get final MVP
+            // Model-View and Model-View-Projection matrices, as the depth pre-pass drew it with
+            const glm::mat4 &MV = objects[i].MV;
+            const glm::mat4 &MVP = objects[i].MVP;
   
+            if (VertexPulling::isEnabled())
+            {
+                // The shader finds the matrices from the instance index
+                glUniform1i(glGetUniformLocation(sceneShaderID, "firstInstance"), i);
 
-            // Send matrices to the vertex shader as uniforms
-            glUniformMatrix4fv(glGetUniformLocation(shaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);// Upload MVP matrix to shader
-            glUniformMatrix4fv(glGetUniformLocation(shaderID, "MV"), 1, GL_FALSE, &MV[0][0]);// Upload MV matrix to shader
+                // Neighbouring crates have no level of detail so each run is one instanced draw
+                if (objects[i].name == "crate")
+                {
+                    unsigned int count = 1;
+                    while (i + count < objects.size() && objects[i + count].name == objects[i].name && !objects[i + count].isStatic
+                           && !objects[i + count].proxied && !objects[i + count].impostor)
+                        count++;
+
+                    crateDrawn.drawInstanced(sceneShaderID, i, count);
+                    i += count - 1;
+                    continue;
+                }
+            }
+            else
+            {
+                // Send matrices to the vertex shader as uniforms
+                glUniformMatrix4fv(glGetUniformLocation(sceneShaderID, "MVP"), 1, GL_FALSE, &MVP[0][0]);// Upload MVP matrix to shader
+                glUniformMatrix4fv(glGetUniformLocation(sceneShaderID, "MV"), 1, GL_FALSE, &MV[0][0]);// Upload MV matrix to shader
+            }
 
 
             // Draw the model
             if (objects[i].name == "teapot")
-                teapot.draw(shaderID);
-
-            if (objects[i].name == "floor")
-                floor.draw(shaderID);
+            {
+                // At full detail skip the meshlets that are off screen or facing away
+                if (objects[i].lod == 0)
+                    teapotDrawn.draw(sceneShaderID, MVP, glm::vec3(glm::inverse(model) * glm::vec4(camera.eye, 1.0f)));
+                else
+                    teapotDrawn.draw(sceneShaderID, objects[i].lod);
+            }
 
             if (objects[i].name == "crate")
-                crate.draw(shaderID);
+                crateDrawn.draw(sceneShaderID);
 
             if (objects[i].name == "wall")
-                wall.draw(shaderID);
+                wall.draw(sceneShaderID);
+        }
+
+        // Draw the static batches with one call per material, their vertices are already in the world
+        if (VertexPulling::isEnabled())
+        {
+            glUniform1i(glGetUniformLocation(sceneShaderID, "firstInstance"), staticInstance);
+        }
+        else
+        {
+            glUniformMatrix4fv(glGetUniformLocation(sceneShaderID, "MVP"), 1, GL_FALSE, &viewProjection[0][0]);
+            glUniformMatrix4fv(glGetUniformLocation(sceneShaderID, "MV"), 1, GL_FALSE, &camera.view[0][0]);
+        }
+        staticBatch.draw(sceneShaderID);
+
+        // Proxies are in the world too
+        for (unsigned int p = 0; p < static_cast<unsigned int>(proxies.size()); p++)
+            hlod.draw(proxies[p], sceneShaderID);
+
+        // Draw the terrain, lit by the same lights
+        glUseProgram(terrainShaderID);
+        sendLightSources(terrainShaderID);
+        terrain.draw(terrainShaderID, floor, camera);
+
+        // Draw the impostors, lit by the same lights
+        if (anyImpostors)
+        {
+            glUseProgram(impostorShaderID);
+            sendLightSources(impostorShaderID);
+            for (unsigned int i = 0; i < static_cast<unsigned int>(objects.size()); i++)
+            {
+                if (objects[i].impostor)
+                    (objects[i].name == "teapot" ? teapotImpostor : crateImpostor).draw(impostorShaderID, objects[i].transform(), camera);
+            }
+        }
+
+        glDepthFunc(GL_LESS);
+        glEndQuery(GL_TIME_ELAPSED);
+        timerQueryPending = true;
+        cpuDrawTime += glfwGetTime() - drawStart;
+
+        // Report the average scene draw times
+        if (time - reportTime >= 2.0 && timedFrames > 0)
+        {
+            printf("%s%s%s: CPU %.3f ms, GPU %.3f ms per frame\n", VertexPulling::isEnabled() ? "Vertex pulling" : "Vertex attributes",
+                   depthPrepass ? " with depth pre-pass" : "", derivedTangents ? " with derived tangents" : "",
+                   1000.0 * cpuDrawTime / timedFrames, 1000.0 * gpuDrawTime / timedFrames);
+            cpuDrawTime = gpuDrawTime = 0.0;
+            timedFrames = 0;
+            reportTime = time;
         }
 
         // ---------------------------------------------------------------------
@@ -454,15 +753,18 @@ int main(void)
         {
             Object& obj = objects[i]; // Reference to current object
 
-            glm::vec3 toCamera = camera.eye - obj.position; // Vector from object to camera
-            float distance = glm::length(toCamera);         // Calculate distance to object center
-            float minDistance = 1.0f;                       // Minimum allowed distance (collision radius)
-
-            if (distance < minDistance && distance > 0.0f)  // If camera is too close and not exactly at center
-            {
-                glm::vec3 pushDir = glm::normalize(toCamera);       // Direction to push camera away
-                camera.eye = obj.position + pushDir * minDistance;  // Push camera to surface of collision radius
-            }            
+            // Model the object is drawn with, its bounds are known once it has loaded
+            Model *objectModel = &teapot;
+            if (obj.name == "crate")
+                objectModel = &crate;
+            else if (obj.name == "wall")
+                objectModel = &wall;
+            if (objectModel->hasFailed() || !objectModel->isReady())
+                continue;
+
+            // Push the camera out of the object's oriented box, keeping it the near plane distance away
+            OrientedBox box = objectModel->worldBounds(obj.transform()).obb;
+            camera.eye = box.pushOut(camera.eye, camera.near);
         }
 
 
@@ -483,7 +785,25 @@ int main(void)
 
     // Cleanup
     teapot.deleteBuffers();
+    sphere.deleteBuffers();
+    crate.deleteBuffers();
+    teapotDerived.deleteBuffers();
+    crateDerived.deleteBuffers();
+    floor.deleteBuffers();
+    wall.deleteBuffers();
+    staticBatch.deleteBuffers();
+    teapotImpostor.deleteBuffers();
+    crateImpostor.deleteBuffers();
+    hlod.deleteBuffers();
+    terrain.deleteBuffers();
+    glDeleteQueries(1, &timerQuery);
     glDeleteProgram(shaderID);
+    glDeleteProgram(pullingShaderID);
+    glDeleteProgram(impostorBakeShaderID);
+    glDeleteProgram(impostorShaderID);
+    glDeleteProgram(hlodBakeShaderID);
+    glDeleteProgram(terrainShaderID);
+    glDeleteProgram(depthShaderID);
 
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
@@ -533,6 +853,24 @@ void keyboardInput(GLFWwindow* window)
         rotateTeapots = false;
     }
 
+    // Switch between vertex attributes and vertex pulling, the draw times are reported for each
+    bool pullingKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (pullingKey && !pullingKeyHeld)
+        VertexPulling::setEnabled(!VertexPulling::isEnabled());
+    pullingKeyHeld = pullingKey;
+
+    // Switch the depth pre-pass on and off
+    bool depthPrepassKey = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+    if (depthPrepassKey && !depthPrepassKeyHeld)
+        depthPrepass = !depthPrepass;
+    depthPrepassKeyHeld = depthPrepassKey;
+
+    // Switch the teapots and crates between vertex and derived tangent frames
+    bool derivedTangentsKey = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (derivedTangentsKey && !derivedTangentsKeyHeld)
+        derivedTangents = !derivedTangents;
+    derivedTangentsKeyHeld = derivedTangentsKey;
+
 }
 
 void mouseInput(GLFWwindow* window)
@@ -547,4 +885,23 @@ void mouseInput(GLFWwindow* window)
     camera.pitch += 0.0005f * float(768 / 2 - yPos);//move the camera up/down depending on mousepos
 }
 
-
+// Send the light sources to a shader, in view space
+void sendLightSources(unsigned int shaderID)
+{
+    for (unsigned int i = 0; i < static_cast<unsigned int>(lightSources.size()); i++)
+    {
+        glm::vec3 viewSpaceLightPosition = glm::vec3(camera.view * glm::vec4(lightSources[i].position, 1.0f));
+        std::string idx = std::to_string(i);
+        glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].colour").c_str()), 1, &lightSources[i].colour[0]);
+        glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].position").c_str()), 1, &viewSpaceLightPosition[0]);
+        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].constant").c_str()), lightSources[i].constant);
+        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].linear").c_str()), lightSources[i].linear);
+        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].quadratic").c_str()), lightSources[i].quadratic);
+        glUniform1i(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].type").c_str()), lightSources[i].type);
+
+        //Spotlight
+        glm::vec3 viewSpaceLightDirection = glm::vec3(camera.view * glm::vec4(lightSources[i].direction, 0.0f));
+        glUniform3fv(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].direction").c_str()), 1, &viewSpaceLightDirection[0]);
+        glUniform1f(glGetUniformLocation(shaderID, ("lightSources[" + idx + "].cosPhi").c_str()), lightSources[i].cosPhi);
+    }
+}
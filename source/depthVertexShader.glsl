@@ -0,0 +1,15 @@
+#version 330 core
+
+// Inputs, the position only stream
+layout(location = 0) in vec3 position;
+
+// Outputs, computed the same way as in the lighting shaders so the depths match exactly
+invariant gl_Position;
+
+// Uniforms
+uniform mat4 MVP;
+
+void main()
+{
+    gl_Position = MVP * vec4(position, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+
+// Outputs
+out vec4 colour;
+
+// Uniforms
+uniform sampler2D source;  // an object's texture, repeating as it does on the object
+
+void main()
+{
+    colour = texture(source, UV);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+// No vertex attributes, the quad covers the whole atlas tile
+
+// Outputs
+out vec2 UV;
+
+// Uniforms
+uniform vec2 uvMin;  // source texture uvs at the corners of the tile
+uniform vec2 uvMax;
+
+void main()
+{
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    gl_Position = vec4(2.0 * corner - 1.0, 0.0, 1.0);
+    UV = mix(uvMin, uvMax, corner);
+}
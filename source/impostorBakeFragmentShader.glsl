@@ -0,0 +1,26 @@
+#version 330 core
+
+// Inputs
+in vec2 UV;
+in vec3 viewTangent;
+in vec3 viewBitangent;
+in vec3 viewNormal;
+
+// Outputs, alpha marks the texels the model covers
+layout(location = 0) out vec4 colour;
+layout(location = 1) out vec4 normal;
+
+// Uniforms
+uniform sampler2D diffuseMap;
+uniform sampler2D normalMap;
+
+void main()
+{
+    // Unlit colour, the lights are applied when the impostor is drawn
+    colour = vec4(vec3(texture(diffuseMap, UV)), 1.0);
+
+    // Normal map moved into the bake camera's space and stored as a colour
+    mat3 TBN  = mat3(normalize(viewTangent), normalize(viewBitangent), normalize(viewNormal));
+    vec3 n    = normalize(TBN * (2.0 * vec3(texture(normalMap, UV)) - 1.0));
+    normal    = vec4(0.5 * n + 0.5, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 330 core
+
+// Inputs
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec4 tangent;  // xyz = tangent, w = handedness of the bitangent
+
+// Outputs
+out vec2 UV;
+out vec3 viewTangent;
+out vec3 viewBitangent;
+out vec3 viewNormal;
+
+// Uniforms
+uniform mat4 MVP;
+uniform mat4 MV;  // bake camera view matrix
+
+void main()
+{
+    // Output vertex position
+    gl_Position = MVP * vec4(position, 1.0);
+    UV = uv;
+
+    // Tangent frame in the bake camera's space, for moving the normal map into it
+    mat3 invMV    = transpose(inverse(mat3(MV)));
+    vec3 t        = normalize(invMV * tangent.xyz);
+    vec3 n        = normalize(invMV * normal);
+    t             = normalize(t - dot(t, n) * n);
+    viewTangent   = t;
+    viewBitangent = cross(n, t) * (tangent.w < 0.0 ? -1.0 : 1.0);
+    viewNormal    = n;
+}
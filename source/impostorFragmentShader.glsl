@@ -0,0 +1,170 @@
+#version 330 core
+
+# define maxLights 10
+
+// Inputs
+in vec2 firstUV;
+in vec2 secondUV;
+in vec3 fragmentPosition;
+in vec3 tangentSpaceLightPosition[maxLights];
+in vec3 tangentSpaceLightDirection[maxLights];
+
+// Outputs
+out vec3 fragmentColour;
+
+// Light struct
+struct Light
+{
+    vec3 position;
+    vec3 colour;
+    float constant;
+    float linear;
+    float quadratic;
+    int type;
+    vec3 direction;
+    float cosPhi;
+};
+
+// Uniforms
+uniform sampler2D colourAtlas;
+uniform sampler2D normalAtlas;
+uniform float blend;  // how far the camera is from the first view towards the second
+uniform float ka;
+uniform float kd;
+uniform float ks;
+uniform float Ns;
+uniform Light lightSources[maxLights];
+
+// Point Light
+vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic);
+
+//Spotlight
+vec3 spotLight(vec3 lightPosition, vec3 direction, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic);
+
+//Directional Light
+vec3 directionalLight(vec3 lightDirection, vec3 lightColour);
+
+// Colour and normal of the model, blended from the two views
+vec3 objectColour;
+vec3 Normal;
+
+void main ()
+{
+    // Texels the model doesn't cover are transparent
+    vec4 colour = mix(texture(colourAtlas, firstUV), texture(colourAtlas, secondUV), blend);
+    if (colour.a < 0.5)
+        discard;
+
+    // Alpha also weights the filtered texels, so divide it back out
+    vec4 normal  = mix(texture(normalAtlas, firstUV), texture(normalAtlas, secondUV), blend);
+    objectColour = colour.rgb / colour.a;
+    Normal       = normalize(2.0 * normal.rgb / max(normal.a, 1e-3) - 1.0);
+
+    fragmentColour = vec3(0.0, 0.0, 0.0);
+    for (int i = 0; i < maxLights; i++)
+    {
+        // Determine light properties for current light source
+        vec3 lightPosition  = tangentSpaceLightPosition[i];
+        vec3 lightDirection = tangentSpaceLightDirection[i];
+        vec3 lightColour    = lightSources[i].colour;
+        float constant      = lightSources[i].constant;
+        float linear        = lightSources[i].linear;
+        float quadratic     = lightSources[i].quadratic;
+        float cosPhi        = lightSources[i].cosPhi;
+
+        if (lightSources[i].type == 1)
+            fragmentColour += pointLight(lightPosition, lightColour, constant, linear, quadratic);
+        if (lightSources[i].type == 2)
+            fragmentColour += spotLight(lightPosition, lightDirection, lightColour, cosPhi, constant, linear, quadratic);
+        if (lightSources[i].type == 3)
+            fragmentColour += directionalLight(lightDirection, lightColour);
+    }
+}
+
+// Calculate point light
+vec3 pointLight(vec3 lightPosition, vec3 lightColour, 
+                float constant, float linear, float quadratic)
+{
+    // Ambient reflection
+    vec3 ambient = ka * objectColour;
+    
+    // Diffuse reflection
+    vec3 light      = normalize(lightPosition - fragmentPosition);
+    vec3 normal     = normalize(Normal);
+    float cosTheta  = max(dot(normal, light), 0);
+    vec3 diffuse    = kd * lightColour * objectColour * cosTheta;
+    
+    // Specular reflection
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(-fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
+    
+    // Attenuation
+    float distance    = length(lightPosition - fragmentPosition);
+    float attenuation = 1.0 / (constant + linear * distance +
+                               quadratic * distance * distance);
+    
+    // Fragment colour
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+// Calculate spotlight
+vec3 spotLight(vec3 lightPosition, vec3 lightDirection, vec3 lightColour, float cosPhi, float constant, float linear, float quadratic)
+{
+    // Ambient reflection
+    vec3 ambient = ka * objectColour;
+    
+    // Diffuse reflection
+    vec3 light     = normalize(lightPosition - fragmentPosition);
+    vec3 normal    = normalize(Normal);
+    float cosTheta = max(dot(normal, light), 0);
+    vec3 diffuse   = kd * lightColour * objectColour * cosTheta;
+    
+    // Specular reflection
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(-fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
+    
+    // Attenuation
+    float distance    = length(lightPosition - fragmentPosition);
+    float attenuation = 1.0 / (constant + linear * distance +
+                               quadratic * distance * distance);
+    
+    // Directional light intensity
+    vec3 direction  = normalize(lightDirection);
+    cosTheta        = dot(-light, direction);
+    //float intensity = 0.0;
+    //if (cosTheta > cosPhi)
+        //intensity = 1.0;
+
+    float delta     = radians(2.0);
+    float intensity = clamp((cosTheta - cosPhi) / delta, 0.0, 1.0);
+    
+    // Return fragment colour
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+
+// Calculate directional light
+vec3 directionalLight(vec3 lightDirection, vec3 lightColour)
+{
+    // Ambient reflection
+    vec3 ambient = ka * objectColour;
+    
+    // Diffuse reflection
+    vec3 light     = normalize(-lightDirection);
+    vec3 normal    = normalize(Normal);
+    float cosTheta = max(dot(normal, light), 0);
+    vec3 diffuse   = kd * lightColour * objectColour * cosTheta;
+    
+    // Specular reflection
+    vec3 reflection = - light + 2 * dot(light, normal) * normal;
+    vec3 camera     = normalize(-fragmentPosition);
+    float cosAlpha  = max(dot(camera, reflection), 0);
+    vec3 specular   = ks * lightColour * pow(cosAlpha, Ns);
+    
+    // Return fragment colour
+    return ambient + diffuse + specular;
+}
\ No newline at end of file
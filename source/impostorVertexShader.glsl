@@ -0,0 +1,54 @@
+#version 330 core
+
+# define maxLights 10
+
+// No vertex attributes, the four corners of the quad come from gl_VertexID
+
+// Outputs
+out vec2 firstUV;
+out vec2 secondUV;
+out vec3 fragmentPosition;
+out vec3 tangentSpaceLightPosition[maxLights];
+out vec3 tangentSpaceLightDirection[maxLights];
+
+struct Light
+{
+    vec3 position;
+    vec3 colour;
+    float constant;
+    float linear;
+    float quadratic;
+    int type;
+    vec3 direction;
+    float cosPhi;
+};
+
+// Uniforms
+uniform vec3 centre;      // centre of the object in view space
+uniform float radius;     // half the width of the quad
+uniform mat4 P;
+uniform vec2 firstCell;   // atlas cells of the two views either side of the camera
+uniform vec2 secondCell;
+uniform vec2 cellSize;
+uniform Light lightSources[maxLights];
+
+void main()
+{
+    // Corner of a quad facing the camera
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    vec3 position = centre + vec3(radius * (2.0 * corner - 1.0), 0.0);
+    gl_Position = P * vec4(position, 1.0);
+
+    // The same corner in both views
+    firstUV  = firstCell + corner * cellSize;
+    secondUV = secondCell + corner * cellSize;
+
+    // The quad's tangent space lines up with view space, which is also the
+    // space the baked normals are in, so the lights pass straight through
+    fragmentPosition = position;
+    for (int i = 0; i < maxLights; i++)
+    {
+        tangentSpaceLightPosition[i]  = lightSources[i].position;
+        tangentSpaceLightDirection[i] = lightSources[i].direction;
+    }
+}
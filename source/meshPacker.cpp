@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include <common/mesh.hpp>
+#include <common/meshcodec.hpp>
+
+// Number of times the packed file is decoded, the fastest run is reported
+const int repeats = 10;
+
+// Size of a file in bytes, 0 if it can't be opened
+static long fileSize(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// Process an .obj file the way the coursework does and write it as a packed
+// mesh, then time decoding it into both vertex layouts
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s input.obj output.cmesh [--optimise] [--meshlets] [--lods count]\n", argv[0]);
+        return 1;
+    }
+
+    // Packing reads the standard layout, the compact one is chosen when the mesh is loaded
+    MeshOptions options;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--optimise") == 0)
+            options.optimise = true;
+        else if (strcmp(argv[i], "--meshlets") == 0)
+            options.meshlets = true;
+        else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc)
+            options.lods = static_cast<unsigned int>(atoi(argv[++i]));
+    }
+
+    Mesh mesh;
+    if (!mesh.load(argv[1], options) || !mesh.pack(argv[2], options))
+    {
+        printf("Unable to pack %s into %s\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    long sourceSize = fileSize(argv[1]);
+    long packedSize = fileSize(argv[2]);
+    printf("%s: %ld bytes, %s: %ld bytes (%.1fx smaller)\n", argv[1], sourceSize, argv[2], packedSize,
+           static_cast<double>(sourceSize) / packedSize);
+
+    for (int compact = 0; compact < 2; compact++)
+    {
+        double best = 1e30;
+        MeshCodec codec;
+        for (int i = 0; i < repeats; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            bool ok = codec.open(argv[2], compact != 0);
+            auto end = std::chrono::high_resolution_clock::now();
+            if (!ok)
+            {
+                printf("Unable to decode %s\n", argv[2]);
+                return 1;
+            }
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (ms < best)
+                best = ms;
+        }
+
+        const MeshStreams &streams = codec.streams();
+        glm::vec3 precision = streams.bounds.box.size() / 65535.0f;
+        printf("%s layout: %u vertices, %u indices decoded in %.3f ms (%.0f MB/s of packed data), "
+               "position steps of %g, %g, %g\n", compact ? "Compact" : "Standard", streams.vertexCount,
+               streams.indexCount, best, packedSize / (best * 1000.0), precision.x, precision.y, precision.z);
+    }
+
+    return 0;
+}
@@ -8,6 +8,7 @@ in vec3 fragmentPosition;
 //in vec3 Normal;
 in vec3 tangentSpaceLightPosition[maxLights];
 in vec3 tangentSpaceLightDirection[maxLights];
+in vec3 viewNormal;  // with derived tangents, when the inputs above are all in view space
 
 // Outputs
 out vec3 fragmentColour;
@@ -34,6 +35,7 @@ uniform float kd;
 uniform float ks;
 uniform float Ns;
 uniform Light lightSources[maxLights];
+uniform bool derivedTangents;
 
 // Point Light
 vec3 pointLight(vec3 lightPosition, vec3 lightColour, float constant, float linear, float quadratic);
@@ -44,11 +46,33 @@ vec3 spotLight(vec3 lightPosition, vec3 direction, vec3 lightColour, float cosPh
 //Directional Light
 vec3 directionalLight(vec3 lightDirection, vec3 lightColour);
 
-// Get the normal vector from the normal map
-vec3 Normal = normalize(2.0 * vec3(texture(normalMap, UV)) - 1.0);
+// Tangent frame from the screen space derivatives of the position and uvs,
+// scaled so it maps the normal map's tangent space onto the surface
+mat3 cotangentFrame(vec3 normal, vec3 position, vec2 uv)
+{
+    vec3 dp1  = dFdx(position);
+    vec3 dp2  = dFdy(position);
+    vec2 duv1 = dFdx(uv);
+    vec2 duv2 = dFdy(uv);
+
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 t       = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 b       = dp2perp * duv1.y + dp1perp * duv2.y;
+    float scale  = inversesqrt(max(max(dot(t, t), dot(b, b)), 1e-20));
+    return mat3(t * scale, b * scale, normal);
+}
+
+// Normal vector from the normal map, set in main
+vec3 Normal;
 
 void main ()
 {
+    // In tangent space, or moved into view space with a derived frame
+    Normal = normalize(2.0 * vec3(texture(normalMap, UV)) - 1.0);
+    if (derivedTangents)
+        Normal = normalize(cotangentFrame(normalize(viewNormal), fragmentPosition, UV) * Normal);
+
     fragmentColour = vec3(0.0, 0.0, 0.0);
     for (int i = 0; i < maxLights; i++)
     {
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include <common/objloader.hpp>
+#include <common/threadpool.hpp>
+
+// Number of times each file is loaded, the fastest run is reported
+const int repeats = 10;
+
+// Time the fastest of several loads of a file in milliseconds
+template <typename Loader>
+double timeLoad(const char *path, Loader loader, ObjData &result)
+{
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++)
+    {
+        ObjData data;
+        auto start = std::chrono::high_resolution_clock::now();
+        loader(path, data);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if (ms < best)
+            best = ms;
+        result = data;
+    }
+    return best;
+}
+
+// Check that both loaders produced exactly the same arrays
+template <typename T>
+bool sameArray(const std::vector<T> &a, const std::vector<T> &b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0);
+}
+
+bool sameData(const ObjData &a, const ObjData &b)
+{
+    return sameArray(a.vertices, b.vertices) && sameArray(a.uvs, b.uvs)
+        && sameArray(a.normals, b.normals) && sameArray(a.vertexIndices, b.vertexIndices)
+        && sameArray(a.uvIndices, b.uvIndices) && sameArray(a.normalIndices, b.normalIndices);
+}
+
+// Stream a file through ObjStream and check every triangle corner has the
+// same attributes as the welded whole file. Returns the time spent in the
+// stream in milliseconds.
+double timeStream(const char *path, size_t budget, unsigned int &chunks, bool &match)
+{
+    ObjData data;
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<unsigned int> indices;
+    match = ObjLoader::load(path, data) && ObjLoader::weld(data, vertices, uvs, normals, indices);
+
+    double ms = 0.0;
+    auto start = std::chrono::high_resolution_clock::now();
+    ObjStream stream;
+    match = stream.open(path, budget) && match;
+    ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    ObjChunk chunk;
+    size_t corner = 0;
+    chunks = 0;
+    while (true)
+    {
+        start = std::chrono::high_resolution_clock::now();
+        bool more = stream.next(chunk);
+        ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        if (!more)
+            break;
+
+        chunks++;
+        for (size_t i = 0; i < chunk.indices.size() && match; i++, corner++)
+        {
+            unsigned int a = chunk.indices[i], b = corner < indices.size() ? indices[corner] : 0;
+            match = corner < indices.size() && chunk.vertices[a] == vertices[b] && chunk.uvs[a] == uvs[b]
+                && chunk.normals[a] == normals[b];
+        }
+    }
+    match = match && corner == indices.size();
+    return ms;
+}
+
+int main(int argc, char **argv)
+{
+    // Benchmark the bundled assets unless files are given on the command line
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        paths.push_back("../assets/cube.obj");
+        paths.push_back("../assets/plane.obj");
+        paths.push_back("../assets/sphere.obj");
+        paths.push_back("../assets/suzanne.obj");
+        paths.push_back("../assets/teapot.obj");
+    }
+
+    // Parallel loads use one chunk per pool thread whatever the file size
+    unsigned int threadCount = ThreadPool::shared().size();
+    auto loadParallel = [threadCount](const char *path, ObjData &data)
+    {
+        return ObjLoader::load(path, data, threadCount);
+    };
+
+    printf("Parallel loads use %u threads\n", threadCount);
+    printf("%-24s %12s %12s %9s %14s %9s %s\n", "file", "fscanf (ms)", "mapped (ms)", "speedup",
+           "parallel (ms)", "speedup", "output");
+    bool allMatch = true;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        ObjData stdioData, mappedData, parallelData;
+        double stdioTime = timeLoad(paths[i], ObjLoader::loadStdio, stdioData);
+        double mappedTime = timeLoad(paths[i], [](const char *path, ObjData &data)
+        {
+            return ObjLoader::load(path, data, 1);
+        }, mappedData);
+        double parallelTime = timeLoad(paths[i], loadParallel, parallelData);
+
+        bool match = sameData(stdioData, mappedData) && sameData(stdioData, parallelData);
+        allMatch = allMatch && match;
+
+        const char *name = strrchr(paths[i], '/') ? strrchr(paths[i], '/') + 1 : paths[i];
+        printf("%-24s %12.3f %12.3f %8.1fx %14.3f %8.1fx %s\n", name, stdioTime, mappedTime,
+               stdioTime / mappedTime, parallelTime, stdioTime / parallelTime,
+               match ? "identical" : "DIFFERENT");
+    }
+
+    // Streamed loads, with a small budget so the bundled files are split into several chunks
+    const size_t streamBudget = 256 * 1024;
+    printf("\nStreamed loads with a %u KB budget\n", static_cast<unsigned int>(streamBudget / 1024));
+    printf("%-24s %12s %9s %s\n", "file", "stream (ms)", "chunks", "output");
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        unsigned int chunks;
+        bool match;
+        double streamTime = timeStream(paths[i], streamBudget, chunks, match);
+        allMatch = allMatch && match;
+
+        const char *name = strrchr(paths[i], '/') ? strrchr(paths[i], '/') + 1 : paths[i];
+        printf("%-24s %12.3f %9u %s\n", name, streamTime, chunks, match ? "identical" : "DIFFERENT");
+    }
+
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#version 330 core
+
+# define maxLights 10
+
+// No vertex attributes, the vertices and matrices are read from buffer textures
+
+//Outputs
+out vec3 fragmentPosition;
+out vec2 UV;
+out vec3 tangentSpaceLightPosition[maxLights];
+out vec3 tangentSpaceLightDirection[maxLights];
+out vec3 viewNormal;  // only with derived tangents
+invariant gl_Position;  // matches the depth pre-pass exactly
+
+struct Light
+{
+    vec3 position;
+    vec3 colour;
+    float constant;
+    float linear;
+    float quadratic;
+    int type;
+    vec3 direction;
+    float cosPhi;
+};
+
+//uniforms
+uniform usamplerBuffer vertexData;   // the geometry arena's vertex buffer as 32-bit words
+uniform samplerBuffer instanceData;  // MVP then MV for each instance, one texel per column
+uniform int firstInstance;           // instance of the first object in the draw
+uniform bool compactVertices;        // packed layout rather than float layout
+uniform int vertexWords;             // 32-bit words per vertex, fewer without tangents
+uniform Light lightSources[maxLights];
+uniform bool derivedTangents;  // no tangents in the vertices, see the fragment shader
+
+// Half float in the low 16 bits of a word (infinities and NaNs aren't expected)
+float unpackHalf(uint bits)
+{
+    uint exponent = (bits >> 10u) & 31u;
+    uint mantissa = bits & 1023u;
+    float value = exponent == 0u ? float(mantissa) * exp2(-24.0)
+                                 : (1.0 + float(mantissa) / 1024.0) * exp2(float(exponent) - 15.0);
+    return (bits & 32768u) != 0u ? -value : value;
+}
+
+// Signed normalised 10, 10, 10, 2 bit vector packed like GL_INT_2_10_10_10_REV
+vec4 unpackSnorm1010102(uint bits)
+{
+    int x = int(bits << 22u) >> 22;
+    int y = int(bits << 12u) >> 22;
+    int z = int(bits << 2u) >> 22;
+    int w = int(bits) >> 30;
+    return max(vec4(float(x) / 511.0, float(y) / 511.0, float(z) / 511.0, float(w)), -1.0);
+}
+
+float fetchFloat(int word)
+{
+    return uintBitsToFloat(texelFetch(vertexData, word).r);
+}
+
+mat4 fetchMatrix(int texel)
+{
+    return mat4(texelFetch(instanceData, texel), texelFetch(instanceData, texel + 1),
+                texelFetch(instanceData, texel + 2), texelFetch(instanceData, texel + 3));
+}
+
+void main()
+{
+    // Fetch the vertex, gl_VertexID already includes the mesh's base vertex
+    vec3 position, normal;
+    vec4 tangent = vec4(0.0);
+    int word = gl_VertexID * vertexWords;
+    if (compactVertices)
+    {
+        position = vec3(fetchFloat(word), fetchFloat(word + 1), fetchFloat(word + 2));
+        uint packedUV = texelFetch(vertexData, word + 3).r;
+        UV = vec2(unpackHalf(packedUV & 65535u), unpackHalf(packedUV >> 16u));
+        normal = unpackSnorm1010102(texelFetch(vertexData, word + 4).r).xyz;
+        if (!derivedTangents)
+            tangent = unpackSnorm1010102(texelFetch(vertexData, word + 5).r);
+    }
+    else
+    {
+        position = vec3(fetchFloat(word), fetchFloat(word + 1), fetchFloat(word + 2));
+        UV = vec2(fetchFloat(word + 3), fetchFloat(word + 4));
+        normal = vec3(fetchFloat(word + 5), fetchFloat(word + 6), fetchFloat(word + 7));
+        if (!derivedTangents)
+            tangent = vec4(fetchFloat(word + 8), fetchFloat(word + 9), fetchFloat(word + 10), fetchFloat(word + 11));
+    }
+
+    // Fetch the instance's matrices
+    int instance = (firstInstance + gl_InstanceID) * 8;
+    mat4 MVP = fetchMatrix(instance);
+    mat4 MV = fetchMatrix(instance + 4);
+
+    // The rest matches vertexShader.glsl
+	gl_Position = MVP * vec4(position, 1.0);
+
+    // Frame built in the fragment shader, as in vertexShader.glsl
+    if (derivedTangents)
+    {
+        viewNormal       = mat3(MV) * normal;
+        fragmentPosition = vec3(MV * vec4(position, 1.0));
+        for (int i = 0; i < maxLights; i++)
+        {
+            tangentSpaceLightPosition[i]  = lightSources[i].position;
+            tangentSpaceLightDirection[i] = lightSources[i].direction;
+        }
+        return;
+    }
+
+    // Calculate the TBN matrix that transforms view space to tangent space
+    mat3 invMV = transpose(inverse(mat3(MV)));
+    vec3 t     = normalize(invMV * tangent.xyz);
+    vec3 n     = normalize(invMV * normal);
+    t          = normalize(t - dot(t, n) * n);
+    vec3 b     = cross(n, t) * (tangent.w < 0.0 ? -1.0 : 1.0);
+    mat3 TBN   = transpose(mat3(t, b, n));
+
+	// Output tangent space fragment position, light positions and directions
+    fragmentPosition = TBN * vec3(MV * vec4(position, 1.0));
+    for (int i = 0; i < maxLights; i++)
+    {
+        tangentSpaceLightPosition[i]  = TBN * lightSources[i].position;
+        tangentSpaceLightDirection[i] = TBN * lightSources[i].direction;
+    }
+}
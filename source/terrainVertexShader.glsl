@@ -0,0 +1,78 @@
+#version 330 core
+
+# define maxLights 10
+
+// Inputs, the vertices are in the world
+layout(location = 0) in vec3 position;
+layout(location = 2) in vec3 normal;
+layout(location = 4) in vec4 morph;  // x = height of the next level at this vertex, yzw = its normal
+
+// Outputs
+out vec3 fragmentPosition;
+out vec2 UV;
+out vec3 tangentSpaceLightPosition[maxLights];
+out vec3 tangentSpaceLightDirection[maxLights];
+out vec3 viewNormal;  // only with derived tangents
+
+struct Light
+{
+    vec3 position;
+    vec3 colour;
+    float constant;
+    float linear;
+    float quadratic;
+    int type;
+    vec3 direction;
+    float cosPhi;
+};
+
+// Uniforms
+uniform mat4 MVP;
+uniform mat4 MV;
+uniform vec3 eye;         // camera position in the world
+uniform vec2 morphRange;  // distances the vertices of this chunk's level start and finish morphing
+uniform float uvScale;
+uniform Light lightSources[maxLights];
+uniform bool derivedTangents;
+
+void main()
+{
+    // Towards the end of the level's range the vertex slides onto the next
+    // level's surface, so it matches the coarser chunks beyond
+    float k       = clamp((distance(position, eye) - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    vec3 morphed  = vec3(position.x, mix(position.y, morph.x, k), position.z);
+    vec3 surface  = normalize(mix(normal, morph.yzw, k));
+    gl_Position   = MVP * vec4(morphed, 1.0);
+
+    // The textures are laid over the ground from above
+    UV = uvScale * morphed.xz;
+
+    // Frame built in the fragment shader, as in vertexShader.glsl
+    if (derivedTangents)
+    {
+        viewNormal       = mat3(MV) * surface;
+        fragmentPosition = vec3(MV * vec4(morphed, 1.0));
+        for (int i = 0; i < maxLights; i++)
+        {
+            tangentSpaceLightPosition[i]  = lightSources[i].position;
+            tangentSpaceLightDirection[i] = lightSources[i].direction;
+        }
+        return;
+    }
+
+    // Tangent along x and bitangent along z, following the uvs
+    mat3 invMV = transpose(inverse(mat3(MV)));
+    vec3 n     = normalize(invMV * surface);
+    vec3 t     = normalize(invMV * vec3(1.0, 0.0, 0.0));
+    t          = normalize(t - dot(t, n) * n);
+    vec3 b     = -cross(n, t);
+    mat3 TBN   = transpose(mat3(t, b, n));
+
+    // Output tangent space fragment position, light positions and directions
+    fragmentPosition = TBN * vec3(MV * vec4(morphed, 1.0));
+    for (int i = 0; i < maxLights; i++)
+    {
+        tangentSpaceLightPosition[i]  = TBN * lightSources[i].position;
+        tangentSpaceLightDirection[i] = TBN * lightSources[i].direction;
+    }
+}
@@ -6,8 +6,7 @@
 layout(location = 0) in vec3 position; //telling OpenGL where to find the position data for the teapot's vertices so the shader can use that to draw the object.
 layout(location = 1) in vec2 uv;//telling OpenGL where to find the texture coordinates so it knows how to map the texture correctly onto the 3D model
 layout(location = 2) in vec3 normal;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec3 bitangent;
+layout(location = 3) in vec4 tangent;//xyz = tangent, w = handedness of the bitangent
 
 //Outputs
 out vec3 fragmentPosition;
@@ -15,6 +14,8 @@ out vec2 UV;//output a 2D vector holding texture coordinates
 //out vec3 Normal;
 out vec3 tangentSpaceLightPosition[maxLights];
 out vec3 tangentSpaceLightDirection[maxLights];
+out vec3 viewNormal;  // only with derived tangents
+invariant gl_Position;  // matches the depth pre-pass exactly
 
 struct Light
 {
@@ -32,6 +33,7 @@ struct Light
 uniform mat4 MVP; //a variable with a value set outside the shader, which is a 4x4 matrix (mat4).
 uniform mat4 MV;
 uniform Light lightSources[maxLights];
+uniform bool derivedTangents;  // the mesh has no tangents, see the fragment shader
 
 void main()
 {
@@ -41,12 +43,27 @@ void main()
 	//Output Vertex Colour
 	UV = uv;
 
+    // Meshes without tangents have the fragment shader build the tangent
+    // frame from screen space derivatives, so everything stays in view space
+    // and no matrix inverse is needed (uniform scaling only)
+    if (derivedTangents)
+    {
+        viewNormal       = mat3(MV) * normal;
+        fragmentPosition = vec3(MV * vec4(position, 1.0));
+        for (int i = 0; i < maxLights; i++)
+        {
+            tangentSpaceLightPosition[i]  = lightSources[i].position;
+            tangentSpaceLightDirection[i] = lightSources[i].direction;
+        }
+        return;
+    }
+
     // Calculate the TBN matrix that transforms view space to tangent space
     mat3 invMV = transpose(inverse(mat3(MV)));
-    vec3 t     = normalize(invMV * tangent);
+    vec3 t     = normalize(invMV * tangent.xyz);
     vec3 n     = normalize(invMV * normal);
     t          = normalize(t - dot(t, n) * n);
-    vec3 b     = cross(n, t);
+    vec3 b     = cross(n, t) * (tangent.w < 0.0 ? -1.0 : 1.0);  // a packed w of -1 can read back as -1/3
     mat3 TBN   = transpose(mat3(t, b, n));
 
 	// Output tangent space fragment position, light positions and directions